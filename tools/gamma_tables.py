@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+# Print the precomputed gamma tables of pngle.c, e.g.
+#   python3 tools/gamma_tables.py > /tmp/gamma.c
+#
+# Same expression as setup_gamma_table() uses at runtime, so a preset gives
+# exactly the table it replaces.
+
+import math
+
+# (gAMA chunk value, display gamma)
+PRESETS = [
+    (100000, 2.2),  # linear image on a 2.2 display
+    (55556, 2.2),   # 1.8 (classic Mac) image on a 2.2 display
+    (45455, 1.0),   # sRGB-ish image on a linear display
+]
+
+
+def main():
+    for png_gamma, display_gamma in PRESETS:
+        exponent = 100000.0 / png_gamma / display_gamma
+        table = [int(math.floor(math.pow(i / 255.0, exponent) * 255.0 + 0.5)) for i in range(256)]
+        name = 'gamma_%d_%s' % (png_gamma, ('%g' % display_gamma).replace('.', '_'))
+        print('static const uint8_t %s[256] = {' % name)
+        for i in range(0, 256, 16):
+            print('  ' + ', '.join('%3d' % v for v in table[i:i + 16]) + ',')
+        print('};')
+        print()
+
+
+if __name__ == '__main__':
+    main()
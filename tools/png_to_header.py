@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Turn a PNG into a PROGMEM array for the sketch, e.g.
+#   python3 tools/png_to_header.py trainer_code/data/manual.png manual > trainer_code/manual.h
+#
+# The chunk CRCs are checked here, once, so the firmware can decode the
+# array with load_file(..., true) and skip them at runtime.
+
+import struct
+import sys
+import zlib
+
+PNG_SIG = b'\x89PNG\r\n\x1a\n'
+
+
+def check_png(data):
+    if data[:8] != PNG_SIG:
+        raise ValueError('not a PNG file')
+
+    pos = 8
+    chunk = None
+    while chunk != b'IEND':
+        if pos + 12 > len(data):
+            raise ValueError('truncated before IEND')
+        length, chunk = struct.unpack('>I4s', data[pos:pos + 8])
+        if pos + 12 + length > len(data):
+            raise ValueError('truncated %s chunk at offset %d' % (chunk.decode('latin-1'), pos))
+        body = data[pos + 4:pos + 8 + length]
+        crc, = struct.unpack('>I', data[pos + 8 + length:pos + 12 + length])
+        if zlib.crc32(body) != crc:
+            raise ValueError('CRC mismatch in %s chunk at offset %d' % (chunk.decode('latin-1'), pos))
+        pos += 12 + length
+
+    if pos != len(data):
+        raise ValueError('%d bytes after IEND' % (len(data) - pos))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: %s <image.png> <array name>' % sys.argv[0])
+
+    data = open(sys.argv[1], 'rb').read()
+    try:
+        check_png(data)
+    except ValueError as e:
+        sys.exit('%s: %s' % (sys.argv[1], e))
+
+    print('// based off of https://www.github.com/Bodmer/PNG_TEST_ONLY')
+    print()
+    print('#include <pgmspace.h>')
+    print('const uint8_t %s[] PROGMEM = {' % sys.argv[2])
+    for i in range(0, len(data), 16):
+        line = ', '.join('0x%02X' % b for b in data[i:i + 16])
+        print(line + (',' if i + 16 < len(data) else ''))
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,142 @@
+/*
+ * crcbench - host side check and benchmark for mz_crc32()
+ *
+ *   make -C tools/pngbench crc                              # default backend
+ *   make -C tools/pngbench crc CRC_DEFS=-DMINIZ_CRC32_IMPL=0  # compact one
+ *   tools/pngbench/crcbench [-t ms]
+ *
+ * mz_crc32() from the sketch's miniz.c is checked against zlib's crc32()
+ * for every length up to 300 at every alignment, and for random buffers
+ * fed in random pieces the way pngle feeds a chunk. The timings compare it
+ * with the compact nibble table CRC miniz shipped with (copied below) and
+ * with zlib, for the buffer sizes pngle sees: chunk types, small chunks,
+ * and IDAT data as it arrives from the file or flash.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "miniz.h"
+
+static const size_t sizes[] = { 4, 13, 64, 1024, 8192, 65536 };
+static volatile uint32_t sink; // keeps the timed CRCs from being optimised out
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// mz_crc32() as it was before the backends, for the timings
+static uint32_t crc32_compact(uint32_t crc, const uint8_t *ptr, size_t buf_len)
+{
+  static const uint32_t s_crc32[16] = { 0, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c };
+  crc = ~crc;
+  while (buf_len--) {
+    uint8_t b = *ptr++;
+    crc = (crc >> 4) ^ s_crc32[(crc & 0xF) ^ (b & 0xF)];
+    crc = (crc >> 4) ^ s_crc32[(crc & 0xF) ^ (b >> 4)];
+  }
+  return ~crc;
+}
+
+static uint32_t crc32_miniz(uint32_t crc, const uint8_t *p, size_t n) { return (uint32_t)mz_crc32(crc, p, n); }
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t *p, size_t n) { return (uint32_t)crc32(crc, p, (uInt)n); }
+
+static int check(const uint8_t *buf, size_t size)
+{
+  int fails = 0;
+
+  if (mz_crc32(0, NULL, 0) != MZ_CRC32_INIT) {
+    printf("FAIL mz_crc32(0, NULL, 0) != MZ_CRC32_INIT\n");
+    fails++;
+  }
+
+  for (size_t align = 0; align < 8; align++) {
+    for (size_t len = 0; len <= 300; len++) {
+      uint32_t want = crc32_zlib(0, buf + align, len);
+      uint32_t got = (uint32_t)mz_crc32(MZ_CRC32_INIT, buf + align, len);
+      if (got != want) {
+        if (fails++ < 10) printf("FAIL len %zu align %zu: %08x vs %08x\n", len, align, got, want);
+      }
+    }
+  }
+
+  for (int round = 0; round < 1000; round++) {
+    size_t len = rand() % size;
+    size_t pos = rand() % (size - len + 1);
+    uint32_t want = crc32_zlib(0, buf + pos, len);
+    uint32_t got = MZ_CRC32_INIT;
+    for (size_t off = 0; off < len; ) {
+      size_t n = rand() % (len - off + 1);
+      if (rand() & 1) n = n % 17; // plenty of short feeds
+      got = (uint32_t)mz_crc32(got, buf + pos + off, n);
+      off += n;
+    }
+    if (got != want) {
+      if (fails++ < 10) printf("FAIL %zu bytes at %zu in pieces: %08x vs %08x\n", len, pos, got, want);
+    }
+  }
+
+  printf("check: %s\n", fails ? "FAILED" : "mz_crc32() matches zlib crc32()");
+  return fails;
+}
+
+// MB/s over buffers of size bytes, the best of five runs that take min_ns together
+static double speed(uint32_t (*fn)(uint32_t, const uint8_t *, size_t), const uint8_t *buf, size_t buf_size, size_t size, double min_ns)
+{
+  double best = 0;
+  for (int run = 0; run < 5; run++) {
+    double bytes = 0, start = now_ns(), t;
+    uint32_t crc = 0;
+    size_t pos = 0;
+    do {
+      for (int i = 0; i < 64; i++) {
+        if (pos + size > buf_size) pos = 0;
+        crc = fn(crc, buf + pos, size);
+        pos += size;
+        bytes += size;
+      }
+    } while ((t = now_ns() - start) < min_ns / 5);
+    sink = crc;
+    if (bytes * 1e3 / t > best) best = bytes * 1e3 / t;
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  double min_ms = 200;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      min_ms = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [-t ms]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const size_t buf_size = 1 << 20;
+  uint8_t *buf = malloc(buf_size);
+  if (!buf) return 1;
+  srand(1);
+  for (size_t i = 0; i < buf_size; i++) buf[i] = (uint8_t)rand();
+
+  int fails = check(buf, buf_size);
+
+  printf("\n%-8s %12s %12s %12s %9s\n", "bytes", "compact MB/s", "mz_crc32", "zlib", "speedup");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    double c = speed(crc32_compact, buf, buf_size, sizes[i], min_ms * 1e6);
+    double m = speed(crc32_miniz, buf, buf_size, sizes[i], min_ms * 1e6);
+    double z = speed(crc32_zlib, buf, buf_size, sizes[i], min_ms * 1e6);
+    printf("%-8zu %12.1f %12.1f %12.1f %8.1fx\n", sizes[i], c, m, z, m / c);
+  }
+
+  free(buf);
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# Write the pngbench test corpus, e.g.
+#   python3 tools/pngbench/gen_corpus.py tools/pngbench/corpus
+#
+# Every color type / bit depth pair PNG allows, plain and Adam7 interlaced,
+# with and without tRNS, a few gAMA chunks, random filter types per row,
+# odd sizes and IDAT split at random points. A handful of screen sized
+# images at the end are what the timings are mostly about. The output only
+# depends on the seed, so results can be compared between runs.
+
+import os
+import random
+import struct
+import sys
+import zlib
+
+CHANNELS = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}
+ADAM7 = [(0, 0, 8, 8), (4, 0, 8, 8), (0, 4, 4, 8), (2, 0, 4, 4), (0, 2, 2, 4), (1, 0, 2, 2), (0, 1, 1, 2)]
+
+
+def chunk(kind, data):
+    return struct.pack('>I', len(data)) + kind + data + struct.pack('>I', zlib.crc32(kind + data))
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def filter_rows(rows, bpp):
+    out = bytearray()
+    prev = bytes(len(rows[0])) if rows else b''
+    for row in rows:
+        ft = random.randint(0, 4)
+        out.append(ft)
+        for i, x in enumerate(row):
+            a = row[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            pred = (0, a, b, (a + b) // 2, paeth(a, b, c))[ft]
+            out.append((x - pred) & 255)
+        prev = row
+    return bytes(out)
+
+
+def pack_row(samples, depth):
+    if depth == 8:
+        return bytes(samples)
+    if depth == 16:
+        return b''.join(struct.pack('>H', s) for s in samples)
+    out = bytearray()
+    acc = bits = 0
+    for s in samples:
+        acc = (acc << depth) | s
+        bits += depth
+        if bits == 8:
+            out.append(acc)
+            acc = bits = 0
+    if bits:
+        out.append(acc << (8 - bits))
+    return bytes(out)
+
+
+def write_png(path, w, h, ct, depth, interlace, trns=False, gama=None, smooth=False):
+    ch = CHANNELS[ct]
+    maxval = (1 << depth) - 1
+    npal = random.randint(1, min(256, 1 << depth)) if ct == 3 else 0
+
+    def sample(x, y, c):
+        if ct == 3:
+            return random.randint(0, npal - 1)
+        if smooth:
+            return (x * 7 + y * 3 + c * 50) * maxval // (w * 7 + h * 3 + 151)
+        if ct in (4, 6) and c == ch - 1 and random.random() < 0.3:
+            return random.choice([0, maxval])
+        return random.randint(0, maxval)
+
+    img = [[[sample(x, y, c) for c in range(ch)] for x in range(w)] for y in range(h)]
+    bpp = max(1, ch * depth // 8)
+
+    def rows(xs, ys):
+        return [pack_row([img[y][x][c] for x in xs for c in range(ch)], depth) for y in ys]
+
+    if interlace:
+        raw = b''
+        for ox, oy, dx, dy in ADAM7:
+            xs, ys = range(ox, w, dx), range(oy, h, dy)
+            if xs and ys:
+                raw += filter_rows(rows(xs, ys), bpp)
+    else:
+        raw = filter_rows(rows(range(w), range(h)), bpp)
+
+    png = b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', struct.pack('>IIBBBBB', w, h, depth, ct, 0, 0, int(interlace)))
+    if gama:
+        png += chunk(b'gAMA', struct.pack('>I', gama))
+    if ct == 3:
+        png += chunk(b'PLTE', bytes(random.randint(0, 255) for _ in range(3 * npal)))
+        if trns:
+            png += chunk(b'tRNS', bytes(random.randint(0, 255) for _ in range(random.randint(1, npal))))
+    elif trns:
+        png += chunk(b'tRNS', b''.join(struct.pack('>H', s) for s in img[0][0]))
+
+    comp = zlib.compress(raw, random.choice([0, 1, 6, 9]))
+    i = 0
+    while i < len(comp):
+        n = random.randint(1, len(comp) // 2 + 1)
+        png += chunk(b'IDAT', comp[i:i + n])
+        i += n
+    png += chunk(b'IEND', b'')
+
+    with open(path, 'wb') as f:
+        f.write(png)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit('usage: gen_corpus.py <dir> [seed]')
+    out = sys.argv[1]
+    random.seed(int(sys.argv[2]) if len(sys.argv) > 2 else 1)
+    os.makedirs(out, exist_ok=True)
+
+    idx = 0
+    for ct, depths in [(0, [1, 2, 4, 8, 16]), (2, [8, 16]), (3, [1, 2, 4, 8]), (4, [8, 16]), (6, [8, 16])]:
+        for depth in depths:
+            for interlace in (0, 1):
+                for w, h in [(1, 1), (5, 3), (74, 74), (33, 17), (200, 9)]:
+                    for trns in ((False, True) if ct in (0, 2, 3) else (False,)):
+                        for gama in (None, 45455, 100000):
+                            if gama and (w, h) != (33, 17):
+                                continue
+                            name = 't%03d_c%d_d%d_i%d_%dx%d_%d_%s.png' % (idx, ct, depth, interlace, w, h, trns, gama)
+                            write_png(os.path.join(out, name), w, h, ct, depth, interlace, trns, gama, smooth=(idx % 3 == 0))
+                            idx += 1
+
+    # Screen sized images; the smooth ones compress like real artwork, and
+    # the larger ones run past the 32K inflate window
+    write_png(os.path.join(out, 'screen_c2.png'), 320, 240, 2, 8, 0, smooth=True)
+    write_png(os.path.join(out, 'screen_c2_i.png'), 320, 240, 2, 8, 1, smooth=True)
+    write_png(os.path.join(out, 'screen_c3_trns.png'), 320, 240, 3, 8, 0, trns=True)
+    write_png(os.path.join(out, 'screen_c6.png'), 300, 200, 6, 8, 0, smooth=True)
+    write_png(os.path.join(out, 'screen_c2_noise_i.png'), 257, 130, 2, 8, 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,90 @@
+/*
+ * inflatecheck - host side check that tinfl_decompress() stays inside a linear output buffer
+ *
+ *   make -C tools/pngbench inflate      # both the 32 and the 64 bit bit-buffer builds
+ *
+ * With TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF (mz_uncompress(),
+ * tinfl_decompress_mem_to_mem()) the output buffer may be exactly the size
+ * of the data, so the fast loop must never write past the end of it.
+ * Streams mixing literals with long matches are compressed with zlib and
+ * inflated into buffers of every size up to the exact size of the data
+ * (most of them end while the fast loop still has input), each followed by
+ * guard bytes that must come back untouched, with the output size and
+ * status checked too.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "miniz.h"
+
+#define GUARD 64
+#define GUARD_BYTE 0xA5
+
+static int check(const char *name, const uint8_t *data, size_t size)
+{
+  uLongf zsize = compressBound(size);
+  uint8_t *z = malloc(zsize);
+  uint8_t *out = malloc(size + GUARD);
+  tinfl_decompressor *inf = malloc(sizeof(tinfl_decompressor));
+  int fails = 0;
+
+  if (!z || !out || !inf || compress2(z, &zsize, data, size, 9) != Z_OK) {
+    printf("FAIL %s: setup\n", name);
+    return 1;
+  }
+
+  for (size_t room = 0; room <= size; room++) {
+    memset(out, GUARD_BYTE, size + GUARD);
+    tinfl_init(inf);
+    size_t in_size = zsize, out_size = room;
+    tinfl_status status = tinfl_decompress(inf, z, &in_size, out, out, &out_size,
+      TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+
+    int bad = out_size > room || memcmp(out, data, out_size);
+    for (size_t i = room; i < size + GUARD; i++) {
+      if (out[i] != GUARD_BYTE) bad = 1;
+    }
+    if (room == size ? status != TINFL_STATUS_DONE || out_size != size : status != TINFL_STATUS_HAS_MORE_OUTPUT) bad = 1;
+    if (bad && fails++ < 5) {
+      printf("FAIL %s: %zu byte buffer for %zu bytes: status %d, %zu bytes out\n", name, room, size, (int)status, out_size);
+    }
+  }
+
+  free(inf);
+  free(out);
+  free(z);
+  return fails;
+}
+
+int main(void)
+{
+  const size_t size = 6000;
+  uint8_t *data = malloc(size);
+  int fails = 0;
+  if (!data) return 1;
+
+  // Runs of 258 bytes (the longest match) after a literal or two, the case the 64 bit fast loop decodes together
+  srand(1);
+  for (size_t i = 0; i < size; ) {
+    size_t lits = 1 + rand() % 3;
+    for (size_t k = 0; k < lits && i < size; k++) data[i++] = (uint8_t)rand();
+    uint8_t b = (uint8_t)rand();
+    for (size_t k = 0; k < 259 && i < size; k++) data[i++] = b;
+  }
+  fails += check("literals + long runs", data, size);
+
+  // Filtered image like data: short repeats, all match lengths
+  for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(i % 7 == 0 ? rand() : i % (3 + rand() % 300) ? data[i ? i - 1 : 0] : rand());
+  fails += check("mixed", data, size);
+
+  // Literals only
+  for (size_t i = 0; i < size; i++) data[i] = (uint8_t)rand();
+  fails += check("random", data, size);
+
+  printf("inflate (%d bit bit buffer): %s\n", (int)(sizeof(tinfl_bit_buf_t) * 8), fails ? "FAILED" : "output stays inside the buffer");
+  free(data);
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,2 @@
+// Host stand-in for the Arduino header, so manual.h builds as plain C
+#define PROGMEM
@@ -0,0 +1,553 @@
+/*
+ * pngbench - host side conformance check and benchmark for pngle
+ *
+ *   make -C tools/pngbench check   # every corpus image against libpng
+ *   make -C tools/pngbench bench   # plus timings
+ *   tools/pngbench/pngbench [-t ms] [-f bytes] [-o 565|rgba|draw] [file.png ...]
+ *
+ * The manual[] array from the sketch is always part of the run. Each image
+ * is decoded by libpng as the reference and by pngle through every output
+ * path (draw callback, RGBA8888 rows, RGB565BE rows + mask), fed whole and
+ * in odd sized slices; any pixel that differs fails the run. The same is
+ * repeated with the decoder settings the sketch uses: a clip rectangle
+ * (which ends the decode early), downscaling, a background and trusted
+ * data with every chunk CRC broken. Their references are made from the
+ * libpng pixels: cropped, box averaged (point sampled when interlaced) and
+ * composited.
+ *
+ * Timings repeat the decode for at least -t milliseconds and report the
+ * PNGLE_STATS stages per image (ns per pixel) and summed over the run
+ * (MB/s of inflated image data, ns per pixel). "convert" is whatever is
+ * left: chunk parsing, CRCs and the pixel kernels.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <png.h>
+
+#include "pngle.h"
+#include "manual.h"
+
+#define SLICE_BYTES 61 // odd on purpose, so chunk headers and rows straddle feeds
+
+typedef struct {
+  const char *name;
+  const uint8_t *data;
+  size_t size;
+} image_t;
+
+typedef struct {
+  uint32_t w, h;
+  uint8_t *rgba; // w * h * 4
+} canvas_t;
+
+typedef enum { PATH_DRAW, PATH_ROW_RGBA, PATH_ROW_565 } out_path_t;
+
+// Decoder settings on top of the output path
+typedef struct {
+  const char *name;
+  int scale; // pngle_set_scale() shift
+  int clip; // pngle_set_clip() to a rectangle around the middle of the output, see clip_rect()
+  int bg; // pngle_set_background(BG_R, BG_G, BG_B)
+  int trusted; // pngle_set_trusted(), fed a copy with every chunk CRC broken
+} settings_t;
+
+#define BG_R 0x20
+#define BG_G 0x90
+#define BG_B 0xe0
+
+static const settings_t settings[] = {
+  // name                            scale clip bg trusted
+  { "plain",                            0,   0,  0, 0 },
+  { "clip",                             0,   1,  0, 0 },
+  { "scale 1/2",                        1,   0,  0, 0 },
+  { "scale 1/8",                        3,   0,  0, 0 },
+  { "background",                       0,   0,  1, 0 },
+  { "scale 1/4 + clip + background",    2,   1,  1, 0 },
+  { "trusted, bad CRCs",                0,   0,  0, 1 },
+};
+
+typedef struct {
+  double total, inflate, unfilter, draw; // ns
+  double inflated, pixels;
+} totals_t;
+
+static const char *path_name[] = { "draw", "rgba", "565" };
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int load(const char *path, image_t *img)
+{
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return -1;
+  fseek(fp, 0, SEEK_END);
+  long n = ftell(fp);
+  rewind(fp);
+  uint8_t *buf = malloc(n > 0 ? n : 1);
+  if (!buf || fread(buf, 1, n, fp) != (size_t)n) {
+    fclose(fp);
+    free(buf);
+    return -1;
+  }
+  fclose(fp);
+
+  const char *base = strrchr(path, '/');
+  img->name = base ? base + 1 : path;
+  img->data = buf;
+  img->size = n;
+  return 0;
+}
+
+
+// ----------------
+// Reference decode
+// ----------------
+
+typedef struct {
+  const uint8_t *p;
+  size_t left;
+} png_src_t;
+
+static void ref_read(png_structp png, png_bytep out, png_size_t n)
+{
+  png_src_t *src = png_get_io_ptr(png);
+  if (n > src->left) png_error(png, "truncated");
+  memcpy(out, src->p, n);
+  src->p += n;
+  src->left -= n;
+}
+
+// libpng with the conversions pngle does: everything to RGBA8888, 16 bit
+// samples rounded to 8 bits, tRNS into alpha, no gamma correction
+static int ref_decode(const image_t *img, canvas_t *c)
+{
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(png);
+  png_bytep *rows = NULL;
+  png_src_t src = { img->data, img->size };
+
+  c->rgba = NULL;
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, NULL);
+    free(rows);
+    free(c->rgba);
+    c->rgba = NULL;
+    return -1;
+  }
+
+  png_set_read_fn(png, &src, ref_read);
+  png_read_info(png, info);
+  png_set_expand(png);
+  png_set_scale_16(png);
+  png_set_gray_to_rgb(png);
+  png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  c->w = png_get_image_width(png, info);
+  c->h = png_get_image_height(png, info);
+  c->rgba = malloc((size_t)c->w * c->h * 4);
+  rows = malloc(c->h * sizeof(*rows));
+  for (uint32_t y = 0; y < c->h; y++) rows[y] = c->rgba + (size_t)y * c->w * 4;
+  png_read_image(png, rows);
+  png_read_end(png, NULL);
+
+  png_destroy_read_struct(&png, &info, NULL);
+  free(rows);
+  return 0;
+}
+
+
+// Output size of one side at 1 / (1 << shift) scale
+static uint32_t scaled_size(uint32_t v, int shift)
+{
+  return (v + (1u << shift) - 1) >> shift;
+}
+
+// Clip rectangle x, y, w, h for an output of w x h: starts a quarter in, reaches a bit past the middle, so the
+// decode ends before the last rows
+static void clip_rect(uint32_t w, uint32_t h, uint32_t r[4])
+{
+  r[0] = w / 4;
+  r[1] = h / 4;
+  r[2] = (w + 1) / 2;
+  r[3] = (h + 1) / 2;
+}
+
+static int interlaced(const image_t *img)
+{
+  return img->size > 28 && img->data[28]; // IHDR interlace method
+}
+
+// What pngle should draw with settings s, made from the libpng pixels in ref (replaced). Compositing comes first,
+// as pngle blends each source pixel; the average weights colors by alpha so transparent pixels don't bleed in.
+// Everything outside the clip rectangle stays as the canvas starts out: zeros
+static void ref_apply(const settings_t *s, int interlace, canvas_t *ref)
+{
+  if (s->bg) {
+    static const uint8_t bg[3] = { BG_R, BG_G, BG_B };
+    for (size_t i = 0; i < (size_t)ref->w * ref->h; i++) {
+      uint8_t *q = ref->rgba + i * 4;
+      for (int c = 0; c < 3; c++) q[c] = (q[c] * q[3] + bg[c] * (255 - q[3]) + 127) / 255;
+      q[3] = 255;
+    }
+  }
+
+  if (s->scale) {
+    uint32_t f = 1u << s->scale;
+    uint32_t w = scaled_size(ref->w, s->scale), h = scaled_size(ref->h, s->scale);
+    uint8_t *out = malloc((size_t)w * h * 4);
+    for (uint32_t oy = 0; oy < h; oy++) {
+      for (uint32_t ox = 0; ox < w; ox++) {
+        uint8_t *q = out + ((size_t)oy * w + ox) * 4;
+        if (interlace) {
+          memcpy(q, ref->rgba + ((size_t)(oy * f) * ref->w + ox * f) * 4, 4);
+          continue;
+        }
+        uint32_t sum[4] = { 0 }, count = 0;
+        for (uint32_t y = oy * f; y < (oy + 1) * f && y < ref->h; y++) {
+          for (uint32_t x = ox * f; x < (ox + 1) * f && x < ref->w; x++) {
+            const uint8_t *p = ref->rgba + ((size_t)y * ref->w + x) * 4;
+            for (int c = 0; c < 3; c++) sum[c] += p[c] * p[3];
+            sum[3] += p[3];
+            count++;
+          }
+        }
+        for (int c = 0; c < 3; c++) q[c] = sum[3] ? (sum[c] + sum[3] / 2) / sum[3] : 0;
+        q[3] = (sum[3] + count / 2) / count;
+      }
+    }
+    free(ref->rgba);
+    ref->rgba = out;
+    ref->w = w;
+    ref->h = h;
+  }
+
+  if (s->clip) {
+    uint32_t r[4];
+    clip_rect(ref->w, ref->h, r);
+    for (uint32_t y = 0; y < ref->h; y++) {
+      for (uint32_t x = 0; x < ref->w; x++) {
+        if (x < r[0] || x >= r[0] + r[2] || y < r[1] || y >= r[1] + r[3]) memset(ref->rgba + ((size_t)y * ref->w + x) * 4, 0, 4);
+      }
+    }
+  }
+}
+
+// Copy of the image with the CRC of every chunk flipped, for pngle_set_trusted()
+static image_t break_crcs(const image_t *img)
+{
+  image_t bad = *img;
+  uint8_t *p = malloc(img->size);
+  memcpy(p, img->data, img->size);
+  for (size_t pos = 8; pos + 12 <= img->size; ) {
+    size_t len = (size_t)p[pos] << 24 | p[pos + 1] << 16 | p[pos + 2] << 8 | p[pos + 3];
+    if (len > img->size - pos - 12) break;
+    p[pos + 8 + len] ^= 0xff;
+    pos += 12 + len;
+  }
+  bad.data = p;
+  return bad;
+}
+
+
+// ----------------
+// pngle decode
+// ----------------
+
+static void on_init(pngle_t *pngle, uint32_t w, uint32_t h)
+{
+  canvas_t *c = pngle_get_user_data(pngle);
+  c->w = w;
+  c->h = h;
+  c->rgba = calloc((size_t)w * h, 4);
+}
+
+static void on_draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4])
+{
+  canvas_t *c = pngle_get_user_data(pngle);
+  if (!c->rgba) return;
+  for (uint32_t j = y; j < y + h && j < c->h; j++) {
+    for (uint32_t i = x; i < x + w && i < c->w; i++) memcpy(c->rgba + ((size_t)j * c->w + i) * 4, rgba, 4);
+  }
+}
+
+static void on_row_rgba(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const void *pixels)
+{
+  canvas_t *c = pngle_get_user_data(pngle);
+  if (!c->rgba) return;
+  memcpy(c->rgba + ((size_t)y * c->w + x) * 4, pixels, (size_t)n * 4);
+}
+
+// Unpacked so it lines up with the reference: r, g, b as the 565 value
+// expanded back, alpha 255 / 0 from the mask
+static void on_row_565(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const void *pixels)
+{
+  canvas_t *c = pngle_get_user_data(pngle);
+  const uint8_t *be = pixels;
+  const uint8_t *mask = pngle_get_row_mask(pngle);
+  if (!c->rgba) return;
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint16_t color = be[i * 2] << 8 | be[i * 2 + 1];
+    uint8_t *q = c->rgba + ((size_t)y * c->w + x + i) * 4;
+    q[0] = color >> 8 & 0xf8;
+    q[1] = color >> 3 & 0xfc;
+    q[2] = color << 3 & 0xf8;
+    q[3] = (!mask || (mask[i >> 3] & (0x80 >> (i & 7)))) ? 255 : 0;
+  }
+}
+
+// Same reduction for the earlier interlace passes and the reference
+static void to_565(canvas_t *c)
+{
+  for (size_t i = 0; i < (size_t)c->w * c->h; i++) {
+    uint8_t *q = c->rgba + i * 4;
+    q[0] &= 0xf8;
+    q[1] &= 0xfc;
+    q[2] &= 0xf8;
+    q[3] = q[3] > 127 ? 255 : 0;
+  }
+}
+
+static void on_draw_565(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4])
+{
+  uint8_t q[4] = { rgba[0] & 0xf8, rgba[1] & 0xfc, rgba[2] & 0xf8, rgba[3] > 127 ? 255 : 0 };
+  on_draw(pngle, x, y, w, h, q);
+}
+
+static int pngle_decode(pngle_t *pngle, const image_t *img, const settings_t *s, out_path_t path, size_t slice, canvas_t *c)
+{
+  pngle_reset(pngle);
+  c->rgba = NULL;
+  pngle_set_trusted(pngle, s->trusted);
+  pngle_set_scale(pngle, s->scale);
+  if (s->bg) pngle_set_background(pngle, BG_R, BG_G, BG_B);
+  else pngle_clear_background(pngle);
+  pngle_clear_clip(pngle);
+  if (s->clip && img->size > 24) {
+    const uint8_t *ihdr = img->data + 16;
+    uint32_t r[4];
+    clip_rect(scaled_size((uint32_t)ihdr[0] << 24 | ihdr[1] << 16 | ihdr[2] << 8 | ihdr[3], s->scale),
+              scaled_size((uint32_t)ihdr[4] << 24 | ihdr[5] << 16 | ihdr[6] << 8 | ihdr[7], s->scale), r);
+    pngle_set_clip(pngle, r[0], r[1], r[2], r[3]);
+  }
+  pngle_set_user_data(pngle, c);
+  pngle_set_init_callback(pngle, on_init);
+  pngle_set_draw_callback(pngle, path == PATH_ROW_565 ? on_draw_565 : on_draw);
+  pngle_set_row_callback(pngle, path == PATH_DRAW ? NULL : path == PATH_ROW_565 ? on_row_565 : on_row_rgba);
+  pngle_set_output_format(pngle, path == PATH_ROW_565 ? PNGLE_OUTPUT_RGB565BE : PNGLE_OUTPUT_RGBA8888);
+
+  size_t pos = 0;
+  while (pos < img->size) {
+    size_t len = slice && img->size - pos > slice ? slice : img->size - pos;
+    int fed = pngle_feed(pngle, img->data + pos, len);
+    if (fed < 0) return -1;
+    if (fed == 0 && len == img->size - pos) return -1; // truncated
+    pos += fed;
+  }
+  return 0;
+}
+
+static int compare(const image_t *img, const char *what, const canvas_t *ref, const canvas_t *got)
+{
+  if (!got->rgba) {
+    printf("FAIL %s [%s]: nothing drawn\n", img->name, what);
+    return 1;
+  }
+  if (got->w != ref->w || got->h != ref->h) {
+    printf("FAIL %s [%s]: size %ux%u, expected %ux%u\n", img->name, what, got->w, got->h, ref->w, ref->h);
+    return 1;
+  }
+  for (uint32_t y = 0; y < ref->h; y++) {
+    for (uint32_t x = 0; x < ref->w; x++) {
+      const uint8_t *a = ref->rgba + ((size_t)y * ref->w + x) * 4;
+      const uint8_t *b = got->rgba + ((size_t)y * ref->w + x) * 4;
+      if (memcmp(a, b, 4)) {
+        printf("FAIL %s [%s]: pixel (%u, %u) is %02x%02x%02x%02x, expected %02x%02x%02x%02x\n",
+               img->name, what, x, y, b[0], b[1], b[2], b[3], a[0], a[1], a[2], a[3]);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int check(pngle_t *pngle, const image_t *img)
+{
+  image_t bad = break_crcs(img);
+  int fails = 0;
+
+  for (size_t k = 0; k < sizeof(settings) / sizeof(settings[0]); k++) {
+    const settings_t *s = &settings[k];
+    canvas_t ref, ref565, got;
+
+    if (ref_decode(img, &ref) < 0) {
+      printf("FAIL %s: libpng could not decode it\n", img->name);
+      fails++;
+      break;
+    }
+    ref_apply(s, interlaced(img), &ref);
+    ref565 = ref;
+    ref565.rgba = malloc((size_t)ref.w * ref.h * 4);
+    memcpy(ref565.rgba, ref.rgba, (size_t)ref.w * ref.h * 4);
+    to_565(&ref565);
+
+    for (int path = PATH_DRAW; path <= PATH_ROW_565; path++) {
+      for (int sl = 0; sl < 2; sl++) {
+        char what[64];
+        snprintf(what, sizeof(what), "%s, %s, %s", s->name, path_name[path], sl ? "sliced" : "whole");
+        if (pngle_decode(pngle, s->trusted ? &bad : img, s, path, sl ? SLICE_BYTES : 0, &got) < 0) {
+          printf("FAIL %s [%s]: %s\n", img->name, what, pngle_error(pngle));
+          fails++;
+        } else {
+          fails += compare(img, what, path == PATH_ROW_565 ? &ref565 : &ref, &got);
+        }
+        free(got.rgba);
+      }
+    }
+
+    free(ref.rgba);
+    free(ref565.rgba);
+  }
+
+  // ... which is only fine because they are trusted
+  canvas_t got;
+  if (pngle_decode(pngle, &bad, &settings[0], PATH_DRAW, 0, &got) == 0) {
+    printf("FAIL %s [bad CRCs]: decoded without pngle_set_trusted()\n", img->name);
+    fails++;
+  }
+  free(got.rgba);
+
+  free((void *)bad.data);
+  return fails ? 1 : 0;
+}
+
+
+// ----------------
+// Timing
+// ----------------
+
+static void bench(pngle_t *pngle, const image_t *img, out_path_t path, size_t slice, double min_ns, totals_t *sum)
+{
+  canvas_t c;
+  totals_t t = { 0 };
+  double ref_ns = 0;
+  int runs = 0, ref_runs = 0;
+
+  double start = now_ns();
+  do {
+    double t0 = now_ns();
+    if (pngle_decode(pngle, img, &settings[0], path, slice, &c) < 0) {
+      printf("%-34s %s\n", img->name, pngle_error(pngle));
+      free(c.rgba);
+      return;
+    }
+    t.total += now_ns() - t0;
+    free(c.rgba);
+
+    const pngle_stats_t *st = pngle_get_stats(pngle);
+    if (st) {
+      t.inflate  += st->cycles_inflate;
+      t.unfilter += st->cycles_unfilter;
+      t.draw     += st->cycles_draw;
+      t.inflated += st->bytes_inflated;
+    }
+    t.pixels += (double)pngle_get_width(pngle) * pngle_get_height(pngle);
+    runs++;
+  } while (now_ns() - start < min_ns);
+
+  start = now_ns();
+  do {
+    if (ref_decode(img, &c) < 0) break;
+    free(c.rgba);
+    ref_runs++;
+  } while ((ref_ns = now_ns() - start) < min_ns);
+
+  double px = t.pixels;
+  printf("%-34s %7zu %7.0f %4d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", img->name, img->size, px / runs, runs,
+         t.total / px, t.inflate / px, t.unfilter / px, (t.total - t.inflate - t.unfilter - t.draw) / px, t.draw / px,
+         ref_runs ? ref_ns / ref_runs / (px / runs) : 0);
+
+  sum->total += t.total / runs;
+  sum->inflate += t.inflate / runs;
+  sum->unfilter += t.unfilter / runs;
+  sum->draw += t.draw / runs;
+  sum->inflated += t.inflated / runs;
+  sum->pixels += px / runs;
+}
+
+static void print_stage(const char *name, double ns, const totals_t *sum)
+{
+  printf("  %-9s %10.0f us %9.2f MB/s %8.1f ns/px\n", name, ns / 1e3, ns > 0 ? sum->inflated / (ns / 1e9) / 1e6 : 0, ns / sum->pixels);
+}
+
+
+int main(int argc, char **argv)
+{
+  double min_ms = 0;
+  size_t slice = 0;
+  out_path_t path = PATH_ROW_565;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-t") && i + 1 < argc) min_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc) slice = strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      const char *o = argv[++i];
+      path = !strcmp(o, "draw") ? PATH_DRAW : !strcmp(o, "rgba") ? PATH_ROW_RGBA : PATH_ROW_565;
+    } else {
+      fprintf(stderr, "usage: %s [-t ms] [-f feed bytes] [-o 565|rgba|draw] [file.png ...]\n"
+                      "  -t  time each image for at least this long (0: conformance check only)\n"
+                      "  -f  feed pngle this many bytes at a time (default: whole image)\n"
+                      "  -o  output path to time (default: RGB565BE rows, as the sketch draws)\n", argv[0]);
+      return 2;
+    }
+  }
+
+  int n_images = argc - i + 1;
+  image_t *images = calloc(n_images, sizeof(*images));
+  images[0].name = "manual[]";
+  images[0].data = manual;
+  images[0].size = sizeof(manual);
+  for (int k = 1; k < n_images; k++) {
+    if (load(argv[i + k - 1], &images[k]) < 0) {
+      fprintf(stderr, "%s: cannot read\n", argv[i + k - 1]);
+      return 2;
+    }
+  }
+
+  pngle_t *pngle = pngle_new();
+  int fails = 0;
+  for (int k = 0; k < n_images; k++) fails += check(pngle, &images[k]);
+  printf("conformance: %d of %d images match libpng %s\n", n_images - fails, n_images, png_get_libpng_ver(NULL));
+
+  if (min_ms > 0) {
+    totals_t sum = { 0 };
+    if (!pngle_get_stats(pngle)) printf("(built without PNGLE_STATS, stage columns are empty)\n");
+    printf("\n%s rows, feeding %s\n", path_name[path], slice ? "in slices" : "whole images");
+    printf("%-34s %7s %7s %4s %8s %8s %8s %8s %8s %8s\n", "ns/pixel", "bytes", "pixels", "runs",
+           "total", "inflate", "unfilter", "convert", "draw", "libpng");
+    for (int k = 0; k < n_images; k++) bench(pngle, &images[k], path, slice, min_ms * 1e6, &sum);
+
+    printf("\nsum of one decode per image: %.0f pixels, %.0f bytes inflated\n", sum.pixels, sum.inflated);
+    print_stage("total", sum.total, &sum);
+    print_stage("inflate", sum.inflate, &sum);
+    print_stage("unfilter", sum.unfilter, &sum);
+    print_stage("convert", sum.total - sum.inflate - sum.unfilter - sum.draw, &sum);
+    print_stage("draw", sum.draw, &sum);
+  }
+
+  pngle_destroy(pngle);
+  for (int k = 1; k < n_images; k++) free((void *)images[k].data);
+  free(images);
+  return fails ? 1 : 0;
+}
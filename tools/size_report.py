@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Flash and RAM use of a firmware image (or object files) by section, and of
+the PNG decoder inside it, e.g.
+  arduino-cli compile -b esp32:esp32:esp32 --output-dir build trainer_code
+  python3 tools/size_report.py build/trainer_code.ino.elf
+
+Uses binutils from the ESP32 toolchain (--prefix, default xtensa-esp32-elf-;
+give --prefix '' for host objects, as tools/pngbench "make size" does).
+Initialised data counts twice: it is stored in flash and copied to RAM.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+# section name -> (flash, RAM region)
+SECTIONS = [
+    (r'^\.flash\.(text|rodata|appdesc)', True, None),
+    (r'^\.iram0\.', True, 'IRAM'),
+    (r'^\.dram0\.(data|rodata)', True, 'DRAM'),
+    (r'^\.dram0\.(bss|noinit)', False, 'DRAM'),
+    (r'^\.rtc\.(text|data|force_fast|force_slow)', True, 'RTC'),
+    (r'^\.rtc\.bss|^\.rtc_noinit', False, 'RTC'),
+    (r'^\.(text|rodata)', True, None),  # host objects
+    (r'^\.data', True, 'RAM'),
+    (r'^\.bss', False, 'RAM'),
+]
+
+
+def run(cmd):
+    try:
+        return subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit('%s: %s' % (cmd[0], e))
+
+
+def classify(name):
+    for pattern, flash, ram in SECTIONS:
+        if re.search(pattern, name):
+            return flash, ram
+    return None
+
+
+def section_sizes(prefix, files):
+    sizes = {}
+    for f in files:
+        for line in run([prefix + 'size', '-A', f]).splitlines():
+            parts = line.split()
+            if len(parts) >= 2 and parts[0].startswith('.') and parts[1].isdigit():
+                # object files built with -ffunction-sections: .text.foo counts as .text
+                name = re.sub(r'^(\.text|\.rodata|\.data\.rel\.ro|\.data|\.bss)\..*', r'\1', parts[0])
+                sizes[name] = sizes.get(name, 0) + int(parts[1])
+    return sizes
+
+
+# (size, nm type, name, source file); the source comes from the debug line
+# info (-l), or is the object file itself when there is none
+def symbols(prefix, files):
+    out = []
+    for f in files:
+        for line in run([prefix + 'nm', '-S', '--size-sort', '-l', f]).splitlines():
+            sym, _, where = line.partition('\t')
+            parts = sym.split()
+            if len(parts) == 4:
+                src = where.rsplit(':', 1)[0] if where else f
+                out.append((int(parts[1], 16), parts[2], re.sub(r'\.\d+$', '', parts[3]), os.path.basename(src)))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('files', nargs='+', help='ELF image or object files')
+    ap.add_argument('--prefix', default='xtensa-esp32-elf-', help='binutils prefix')
+    ap.add_argument('--match', default=r'^(miniz|pngle)\.', help='source files to itemise (regex)')
+    ap.add_argument('--top', type=int, default=10, help='largest symbols to list per source file')
+    args = ap.parse_args()
+
+    sizes = section_sizes(args.prefix, args.files)
+    flash_total = 0
+    ram_total = {}
+    print('%-28s %9s  %s' % ('section', 'bytes', 'stored in'))
+    for name, size in sorted(sizes.items(), key=lambda kv: -kv[1]):
+        where = classify(name)
+        if not where or not size:
+            continue
+        flash, ram = where
+        flash_total += size if flash else 0
+        if ram:
+            ram_total[ram] = ram_total.get(ram, 0) + size
+        print('%-28s %9d  %s' % (name, size, ' + '.join(x for x in ('flash' if flash else None, ram) if x)))
+    print('%-28s %9d' % ('flash', flash_total))
+    for ram, size in sorted(ram_total.items()):
+        print('%-28s %9d' % (ram, size))
+
+    syms = symbols(args.prefix, args.files)
+    for src in sorted(set(s[3] for s in syms if re.search(args.match, s[3]))):
+        mine = [s for s in syms if s[3] == src]
+        code = sum(s[0] for s in mine if s[1] in 'Tt')
+        const = sum(s[0] for s in mine if s[1] in 'Rr')
+        data = sum(s[0] for s in mine if s[1] in 'Dd')
+        bss = sum(s[0] for s in mine if s[1] in 'Bb')
+        print('\n%s: %d code, %d const, %d data, %d bss' % (src, code, const, data, bss))
+        for size, kind, name, _ in sorted(mine, reverse=True)[:args.top]:
+            print('  %7d %s %s' % (size, kind, name))
+
+
+if __name__ == '__main__':
+    main()
@@ -32,6 +32,9 @@ class UI {
       // setup anything that is needed while the boot menu is there.
       setup_controls();
 
+      // Claim the memory for composing pages while the heap is still in one piece.
+      setupPage();
+
       // Go into the actual program.
       delay(1000);
       // Set the inital background to white.
@@ -59,6 +62,11 @@ class UI {
         // If a new page has been selected, change to it.
         changePage(_tft);
 
+        // Keep drawing any image that is still loading, a little at a time, and show its page once it is done.
+        if (!pngLoader.step(PNG_STEP_US) && pagePending) {
+          pushPage();
+        }
+
         // If the info page is currently selected, update the button sensors.
         updateInfo(_tft);
       }
@@ -250,6 +258,33 @@ class UI {
 
     bool confHov[2] = {true, false};
 
+    /*
+      IMAGE VARIABLES
+    */
+
+    // Draws page images across loop iterations so the sensors keep being polled.
+    PngLoader pngLoader;
+
+    // Time spent decoding images per loop iteration, in microseconds.
+    const uint32_t PNG_STEP_US = 2000;
+
+    /*
+      PAGE COMPOSITING VARIABLES
+    */
+
+    // Pages are drawn into this sprite and pushed to the screen in one transfer, so they never show up half drawn
+    // and drawing over something costs no SPI time. 16 bit keeps the colors exact, 8 bit halves the memory.
+    // It is allocated once at startup and kept, at 8 bit if 16 doesn't fit; without room for either, pages are drawn
+    // straight to the screen.
+    const uint8_t PAGE_COLOR_DEPTH = 16;
+
+    TFT_eSprite pageSprite = TFT_eSprite(&tft);
+    PngSpriteTarget pageTarget{pageSprite};
+    PngRenderer pageRenderer{pageTarget};
+
+    // The page in the sprite is waiting for its image to finish decoding before it is pushed.
+    bool pagePending = false;
+
     /*
       BOOT AND SETUP FUNCTIONS
     */
@@ -405,22 +440,22 @@ class UI {
       if (currSel != lastCurrSel) {
         // If the home page has been selected, output the homepage.
         if (menuPage[HOME]) {
-          createHome(_tft);
+          composePage(_tft, &UI::createHome);
         }
 
         // If the info page has been selected, output the info page.
         if (menuPage[INFO]) {
-          createInfo(_tft);
+          composePage(_tft, &UI::createInfo);
         }
 
         // If the help page has been selected, output the help page.
         if (menuPage[HELP]) {
-          createHelp(_tft);
+          composePage(_tft, &UI::createHelp);
         }
 
         // If the bench page has been selected, output the benchmark page.
         if (menuPage[BENCH]) {
-          createBench(_tft);
+          composePage(_tft, &UI::createBench);
         }
 
         lastCurrSel = currSel;
@@ -576,7 +611,7 @@ class UI {
     }
 
     void benchLoop(TFT_eSPI &_tft) {
-      createConf(_tft);
+      composePage(_tft, &UI::createConf);
       bool conf = true;
 
       while (conf) {
@@ -591,6 +626,7 @@ class UI {
 
       if (confHov[1]) {
         _tft.setFreeFont(sansBold);
+        _tft.setTextColor(TFT_BLACK);
 
         _tft.fillRect(0, 0, PAGE_W, PAGE_H, TFT_SILVER);
         for (int i = 0; i < 4; i++) {
@@ -638,13 +674,11 @@ class UI {
         _tft.drawString(String(repsDone), PAGE_W / 2 + _tft.textWidth("Your Score: ") / 3 + 4, PAGE_H / 2 - _tft.fontHeight() / 2);
         delay(5000);
       } else {
-        _tft.fillRect(0, 0, PAGE_W, PAGE_H, TFT_NAVY);
-        _tft.drawString(NO_TOP, PAGE_W / 2 - _tft.textWidth(NO_TOP) / 2, PAGE_H / 2 - _tft.fontHeight());
-        _tft.drawString(NO_BOT, PAGE_W / 2 - _tft.textWidth(NO_BOT) / 2, PAGE_H / 2);
+        composePage(_tft, &UI::createNoBench);
         delay(5000);
       }
 
-      createBench(_tft);
+      composePage(_tft, &UI::createBench);
     }
 
     const String benchCountdown[4] = {"3", "2", "1", "Go!"};
@@ -686,6 +720,53 @@ class UI {
       minClock(_tft, 3 + _tft.textWidth(repString) + 2 + _tft.textWidth("999") + 30 + _tft.textWidth(timeString) + 15, (D_HEIGHT - 24 + 3), currentTime - startTime, BAR_TEXT_COLOR, BAR_COLOR);
     }
 
+    /*
+      PAGE COMPOSITING FUNCTIONS
+    */
+
+    // Allocate the page sprite for good, at 8 bit if there isn't room for PAGE_COLOR_DEPTH.
+    void setupPage() {
+      pageSprite.setColorDepth(PAGE_COLOR_DEPTH);
+      if (!pageSprite.createSprite(PAGE_W, PAGE_H)) {
+        pageSprite.setColorDepth(8);
+        pageSprite.createSprite(PAGE_W, PAGE_H);
+      }
+    }
+
+    // Draw a page off screen, then push it to the screen in one go; with an image still decoding, the main loop
+    // pushes it once the image is done. Without the page sprite, draw on the screen as before.
+    void composePage(TFT_eSPI &_tft, void (UI::*create)(TFT_eSPI &)) {
+      // Stop drawing the image of the previous page.
+      pngLoader.cancel();
+      pagePending = false;
+
+      if (!pageSprite.created()) {
+        (this->*create)(_tft);
+        return;
+      }
+
+      (this->*create)(pageSprite);
+      pagePending = true;
+      if (!pngLoader.busy()) {
+        pushPage();
+      }
+    }
+
+    void pushPage() {
+      pageSprite.pushSprite(0, 0);
+      pagePending = false;
+    }
+
+    // Draw a png with its top left corner at (x, y) over the color bg, a little per loop iteration: into the page
+    // sprite while composing, else straight to the screen.
+    void drawImage(TFT_eSPI &_tft, int16_t x, int16_t y, uint16_t bg, const uint8_t *data, uint32_t size) {
+      PngRenderer &renderer = (&_tft == &pageSprite) ? pageRenderer : pngRenderer;
+      pngLoader.setRenderer(renderer);
+      renderer.setPosition(x, y);
+      renderer.setBackground(bg);
+      pngLoader.begin(data, size, true);
+    }
+
     void createHome(TFT_eSPI &_tft) {
       _tft.fillRect(0, 0, PAGE_W, PAGE_H, TFT_SILVER);
       _tft.setTextColor(TFT_BLACK);
@@ -711,8 +792,7 @@ class UI {
         _tft.drawString(HELP_TEXT[i], 5, 5+_tft.fontHeight()*i);
       }
 
-      setPngPosition(PAGE_W-QR_CODE_SIDE_L, PAGE_H-QR_CODE_SIDE_L);
-      load_file(manual, sizeof(manual));
+      drawImage(_tft, PAGE_W-QR_CODE_SIDE_L, PAGE_H-QR_CODE_SIDE_L, TFT_SILVER, manual, sizeof(manual));
     }
 
     void createBench(TFT_eSPI &_tft) {
@@ -769,4 +849,13 @@ class UI {
       _tft.drawString(N_CONF, PAGE_W / 2 - CONF_BUT_W / 2 - 5 - _tft.textWidth(N_CONF) / 2, PAGE_H / 2 + CONF_BUT_H / 2 - _tft.fontHeight() / 2 + 2);
       _tft.drawString(Y_CONF, PAGE_W / 2 + CONF_BUT_W / 2 + 5 - _tft.textWidth(Y_CONF) / 2, PAGE_H / 2 + CONF_BUT_H / 2 - _tft.fontHeight() / 2 + 2);
     }
+
+    // Function to create the page shown when the benchmark is declined.
+    void createNoBench(TFT_eSPI &_tft) {
+      _tft.fillRect(0, 0, PAGE_W, PAGE_H, TFT_NAVY);
+      _tft.setFreeFont(sansBold);
+      _tft.setTextColor(TFT_BLACK);
+      _tft.drawString(NO_TOP, PAGE_W / 2 - _tft.textWidth(NO_TOP) / 2, PAGE_H / 2 - _tft.fontHeight());
+      _tft.drawString(NO_BOT, PAGE_W / 2 - _tft.textWidth(NO_BOT) / 2, PAGE_H / 2);
+    }
 };
@@ -161,6 +161,31 @@
 
 #include <stdlib.h>
 
+// Build profile: pngle only needs tinfl_decompress() and mz_crc32(), so everything else is compiled out
+// (MINIZ_INFLATE_ONLY). Uncomment MINIZ_WITH_DEFLATE for a feature that has to compress; it brings back tdefl
+// and adler-32, the rest of the switches below stay as they are.
+//#define MINIZ_WITH_DEFLATE
+
+#ifndef MINIZ_WITH_DEFLATE
+#define MINIZ_INFLATE_ONLY
+#endif
+
+// Bits of a Huffman code resolved by a single table lookup in tinfl, 9 - 12; longer codes walk a tree. Every step up
+// doubles the three lookup tables inside tinfl_decompressor (6KB at 10). Set it here, or for every file of the build.
+#ifndef TINFL_FAST_LOOKUP_BITS
+#define TINFL_FAST_LOOKUP_BITS 10
+#endif
+
+// mz_crc32() backend, picked at compile time: 0 = compact nibble table (64 bytes), 1 = slice-by-8 (8KB table, built
+// on first use), 2 = the CRC-32 in the ESP32 mask ROM (no flash or RAM at all). pngle runs it over every chunk.
+#ifndef MINIZ_CRC32_IMPL
+  #if defined(ESP_PLATFORM) || defined(ARDUINO_ARCH_ESP32)
+    #define MINIZ_CRC32_IMPL 2
+  #else
+    #define MINIZ_CRC32_IMPL 1
+  #endif
+#endif
+
 // Defines to completely disable specific portions of miniz.c:
 // If all macros here are defined the only functionality remaining will be CRC-32, adler-32, tinfl, and tdefl.
 
@@ -190,9 +215,17 @@
 // functions (such as tdefl_compress_mem_to_heap() and tinfl_decompress_mem_to_heap()) won't work.
 //#define MINIZ_NO_MALLOC
 
-// 
+#ifdef MINIZ_INFLATE_ONLY
+// Define MINIZ_NO_COMPRESSION to disable tdefl, the deflate compressor (and its ~2KB of static tables).
 #define MINIZ_NO_COMPRESSION
 
+// Define MINIZ_NO_ADLER32 to drop mz_adler32(); only tdefl calls it, tinfl checks the zlib adler-32 inline.
+#define MINIZ_NO_ADLER32
+
+// Define MINIZ_NO_INFLATE_HELPERS to drop tinfl_decompress_mem_to_heap/_mem/_callback(), leaving tinfl_decompress().
+#define MINIZ_NO_INFLATE_HELPERS
+#endif
+
 
 #if defined(__TINYC__) && (defined(__linux) || defined(__linux__))
   // TODO: Work around "error: include file 'sys\utime.h' when compiling with tcc on Linux
@@ -236,8 +269,10 @@ typedef unsigned long mz_ulong;
 void mz_free(void *p);
 
 #define MZ_ADLER32_INIT (1)
+#ifndef MINIZ_NO_ADLER32
 // mz_adler32() returns the initial adler-32 value to use when called with ptr==NULL.
 mz_ulong mz_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len);
+#endif
 
 #define MZ_CRC32_INIT (0)
 // mz_crc32() returns the initial CRC-32 value to use when called with ptr==NULL.
@@ -697,6 +732,7 @@ enum
   TINFL_FLAG_COMPUTE_ADLER32 = 8
 };
 
+#ifndef MINIZ_NO_INFLATE_HELPERS
 // High level decompression functions:
 // tinfl_decompress_mem_to_heap() decompresses a block in memory to a heap block allocated via malloc().
 // On entry:
@@ -716,6 +752,7 @@ size_t tinfl_decompress_mem_to_mem(void *pOut_buf, size_t out_buf_len, const voi
 // Returns 1 on success or 0 on failure.
 typedef int (*tinfl_put_buf_func_ptr)(const void* pBuf, int len, void *pUser);
 int tinfl_decompress_mem_to_callback(const void *pIn_buf, size_t *pIn_buf_size, tinfl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
+#endif // #ifndef MINIZ_NO_INFLATE_HELPERS
 
 struct tinfl_decompressor_tag; typedef struct tinfl_decompressor_tag tinfl_decompressor;
 
@@ -745,7 +782,7 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
 enum
 {
   TINFL_MAX_HUFF_TABLES = 3, TINFL_MAX_HUFF_SYMBOLS_0 = 288, TINFL_MAX_HUFF_SYMBOLS_1 = 32, TINFL_MAX_HUFF_SYMBOLS_2 = 19,
-  TINFL_FAST_LOOKUP_BITS = 10, TINFL_FAST_LOOKUP_SIZE = 1 << TINFL_FAST_LOOKUP_BITS
+  TINFL_FAST_LOOKUP_SIZE = 1 << TINFL_FAST_LOOKUP_BITS
 };
 
 typedef struct
@@ -754,7 +791,7 @@ typedef struct
   mz_int16 m_look_up[TINFL_FAST_LOOKUP_SIZE], m_tree[TINFL_MAX_HUFF_SYMBOLS_0 * 2];
 } tinfl_huff_table;
 
-#if MINIZ_HAS_64BIT_REGISTERS
+#if !defined(TINFL_USE_64BIT_BITBUF) && MINIZ_HAS_64BIT_REGISTERS
   #define TINFL_USE_64BIT_BITBUF 1
 #endif
 
@@ -963,9 +1000,11 @@ typedef unsigned char mz_validate_uint64[sizeof(mz_uint64)==8 ? 1 : -1];
 #if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
   #define MZ_READ_LE16(p) *((const mz_uint16 *)(p))
   #define MZ_READ_LE32(p) *((const mz_uint32 *)(p))
+  #define MZ_READ_LE64(p) *((const mz_uint64 *)(p))
 #else
   #define MZ_READ_LE16(p) ((mz_uint32)(((const mz_uint8 *)(p))[0]) | ((mz_uint32)(((const mz_uint8 *)(p))[1]) << 8U))
   #define MZ_READ_LE32(p) ((mz_uint32)(((const mz_uint8 *)(p))[0]) | ((mz_uint32)(((const mz_uint8 *)(p))[1]) << 8U) | ((mz_uint32)(((const mz_uint8 *)(p))[2]) << 16U) | ((mz_uint32)(((const mz_uint8 *)(p))[3]) << 24U))
+  #define MZ_READ_LE64(p) ((mz_uint64)MZ_READ_LE32(p) | ((mz_uint64)MZ_READ_LE32((const mz_uint8 *)(p) + 4) << 32U))
 #endif
 
 #ifdef _MSC_VER
@@ -976,12 +1015,28 @@ typedef unsigned char mz_validate_uint64[sizeof(mz_uint64)==8 ? 1 : -1];
   #define MZ_FORCEINLINE inline
 #endif
 
+#if MINIZ_CRC32_IMPL == 2
+  #if defined(__has_include)
+    #if __has_include("esp_rom_crc.h")
+      #define MZ_HAS_ESP_ROM_CRC_H
+    #endif
+  #endif
+  #ifdef MZ_HAS_ESP_ROM_CRC_H
+    #include "esp_rom_crc.h" // ESP-IDF 4.2 and later
+    #define MZ_ROM_CRC32_LE esp_rom_crc32_le
+  #else
+    #include "rom/crc.h"
+    #define MZ_ROM_CRC32_LE crc32_le
+  #endif
+#endif
+
 #ifdef __cplusplus
   extern "C" {
 #endif
 
 // ------------------- zlib-style API's
 
+#ifndef MINIZ_NO_ADLER32
 mz_ulong mz_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len)
 {
   mz_uint32 i, s1 = (mz_uint32)(adler & 0xffff), s2 = (mz_uint32)(adler >> 16); size_t block_len = buf_len % 5552;
@@ -996,7 +1051,50 @@ mz_ulong mz_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len)
   }
   return (s2 << 16) + s1;
 }
+#endif // #ifndef MINIZ_NO_ADLER32
 
+#if MINIZ_CRC32_IMPL == 2
+// The ROM routine inverts the CRC on the way in and out like zlib's crc32(), so results chain the same way.
+mz_ulong mz_crc32(mz_ulong crc, const mz_uint8 *ptr, size_t buf_len)
+{
+  if (!ptr) return MZ_CRC32_INIT;
+  return MZ_ROM_CRC32_LE((mz_uint32)crc, ptr, (mz_uint32)buf_len);
+}
+#elif MINIZ_CRC32_IMPL == 1
+// Slice-by-8: eight bytes per step through eight 256 entry tables, s_crc32[k][i] being the CRC of byte i followed
+// by k zero bytes. Filling the tables twice (from two threads) writes the same values, so no lock.
+static mz_uint32 s_crc32[8][256];
+static int s_crc32_ready;
+
+static void mz_crc32_init_tables(void)
+{
+  mz_uint32 i, k, c;
+  for (i = 0; i < 256; ++i)
+  {
+    for (c = i, k = 0; k < 8; ++k) c = (c >> 1) ^ (0xedb88320 & (0 - (c & 1)));
+    s_crc32[0][i] = c;
+  }
+  for (i = 0; i < 256; ++i)
+    for (k = 1; k < 8; ++k) s_crc32[k][i] = (s_crc32[k - 1][i] >> 8) ^ s_crc32[0][s_crc32[k - 1][i] & 0xFF];
+  s_crc32_ready = 1;
+}
+
+mz_ulong mz_crc32(mz_ulong crc, const mz_uint8 *ptr, size_t buf_len)
+{
+  mz_uint32 crcu32 = (mz_uint32)crc;
+  if (!ptr) return MZ_CRC32_INIT;
+  if (!s_crc32_ready) mz_crc32_init_tables();
+  crcu32 = ~crcu32;
+  for ( ; buf_len >= 8; ptr += 8, buf_len -= 8)
+  {
+    mz_uint32 lo = MZ_READ_LE32(ptr) ^ crcu32, hi = MZ_READ_LE32(ptr + 4);
+    crcu32 = s_crc32[7][lo & 0xFF] ^ s_crc32[6][(lo >> 8) & 0xFF] ^ s_crc32[5][(lo >> 16) & 0xFF] ^ s_crc32[4][lo >> 24] ^
+             s_crc32[3][hi & 0xFF] ^ s_crc32[2][(hi >> 8) & 0xFF] ^ s_crc32[1][(hi >> 16) & 0xFF] ^ s_crc32[0][hi >> 24];
+  }
+  while (buf_len--) crcu32 = (crcu32 >> 8) ^ s_crc32[0][(crcu32 ^ *ptr++) & 0xFF];
+  return ~crcu32;
+}
+#else
 // Karl Malbrain's compact CRC-32. See "A compact CCITT crc16 and crc32 C implementation that balances processor cache usage against speed": http://www.geocities.com/malbrain/
 mz_ulong mz_crc32(mz_ulong crc, const mz_uint8 *ptr, size_t buf_len)
 {
@@ -1007,6 +1105,7 @@ mz_ulong mz_crc32(mz_ulong crc, const mz_uint8 *ptr, size_t buf_len)
   crcu32 = ~crcu32; while (buf_len--) { mz_uint8 b = *ptr++; crcu32 = (crcu32 >> 4) ^ s_crc32[(crcu32 & 0xF) ^ (b & 0xF)]; crcu32 = (crcu32 >> 4) ^ s_crc32[(crcu32 & 0xF) ^ (b >> 4)]; }
   return ~crcu32;
 }
+#endif // MINIZ_CRC32_IMPL
 
 void mz_free(void *p)
 {
@@ -1437,14 +1536,78 @@ const char *mz_error(int err)
     code_len = TINFL_FAST_LOOKUP_BITS; do { temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0); \
   } sym = temp; bit_buf >>= code_len; num_bits -= code_len; } MZ_MACRO_END
 
+// The fast loop runs while this much input is left, so its word sized refills never check for the end of the input,
+// and while a whole match (up to 258 bytes) fits in the output buffer - after the literal the 64 bit loop may decode
+// ahead of it in the same pass.
+#define TINFL_FAST_INPUT_MIN 16
+#define TINFL_FAST_OUTPUT_MIN (258 + 1)
+
+// TINFL_FAST_REFILL() tops the bit buffer up to at least TINFL_BITBUF_SIZE - 8 bits with one unaligned word read,
+// consuming only the whole bytes that fit; bits above num_bits stay clear for the byte wise code above.
+#if TINFL_USE_64BIT_BITBUF
+#define TINFL_FAST_REFILL() do { \
+  bit_buf |= (tinfl_bit_buf_t)MZ_READ_LE64(pIn_buf_cur) << num_bits; pIn_buf_cur += (63 - num_bits) >> 3; num_bits |= 56; \
+  bit_buf &= ((tinfl_bit_buf_t)1 << num_bits) - 1; } MZ_MACRO_END
+#else
+#define TINFL_FAST_REFILL() do { \
+  bit_buf |= (tinfl_bit_buf_t)MZ_READ_LE32(pIn_buf_cur) << num_bits; pIn_buf_cur += (31 - num_bits) >> 3; num_bits |= 24; \
+  bit_buf &= ((tinfl_bit_buf_t)1 << num_bits) - 1; } MZ_MACRO_END
+#endif
+
+// TINFL_FAST_DECODE() decodes a symbol when the bit buffer is known to hold at least 15 bits.
+#define TINFL_FAST_DECODE(sym, pHuff) do { \
+  int temp; mz_uint code_len; \
+  if ((temp = (pHuff)->m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)]) >= 0) \
+    code_len = temp >> 9, temp &= 511; \
+  else { \
+    code_len = TINFL_FAST_LOOKUP_BITS; do { temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0); \
+  } sym = temp; bit_buf >>= code_len; num_bits -= code_len; } MZ_MACRO_END
+
+// Copies a match of len bytes to pOut, which has room for all of it. In a circular output buffer pSrc may lie at or
+// after pOut (the match starts in the previous lap of the window) and run past pOut_buf_end, continuing at
+// pOut_buf_start; then it goes in two pieces instead of a byte at a time, the second one possibly shorter than 3.
+static MZ_FORCEINLINE mz_uint8 *tinfl_copy_match(mz_uint8 *pOut, const mz_uint8 *pSrc, mz_uint len, mz_uint8 *pOut_buf_start, const mz_uint8 *pOut_buf_end)
+{
+  size_t dist;
+  if (pSrc >= pOut)
+  {
+    size_t n = pOut_buf_end - pSrc;
+    if (n >= len) { memmove(pOut, pSrc, len); return pOut + len; }
+    memmove(pOut, pSrc, n); pOut += n; len -= (mz_uint)n; pSrc = pOut_buf_start;
+    if (len < 3) { pOut[0] = pSrc[0]; if (len > 1) pOut[1] = pSrc[1]; return pOut + len; }
+  }
+  dist = pOut - pSrc;
+#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES
+  if ((len >= 9) && (len <= dist))
+  {
+    const mz_uint8 *pSrc_end = pSrc + (len & ~7);
+    do
+    {
+      ((mz_uint32 *)pOut)[0] = ((const mz_uint32 *)pSrc)[0];
+      ((mz_uint32 *)pOut)[1] = ((const mz_uint32 *)pSrc)[1];
+      pOut += 8;
+    } while ((pSrc += 8) < pSrc_end);
+    if ((len &= 7) < 3)
+    {
+      if (len) { pOut[0] = pSrc[0]; if (len > 1) pOut[1] = pSrc[1]; pOut += len; }
+      return pOut;
+    }
+  }
+#endif
+  (void)dist;
+  do { pOut[0] = pSrc[0]; pOut[1] = pSrc[1]; pOut[2] = pSrc[2]; pOut += 3; pSrc += 3; } while ((int)(len -= 3) > 2);
+  if ((int)len > 0) { pOut[0] = pSrc[0]; if ((int)len > 1) pOut[1] = pSrc[1]; pOut += len; }
+  return pOut;
+}
+
 tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
 {
-  static const int s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
-  static const int s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
-  static const int s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
-  static const int s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+  static const mz_uint16 s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
+  static const mz_uint8 s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+  static const mz_uint16 s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
+  static const mz_uint8 s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
   static const mz_uint8 s_length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
-  static const int s_min_table_sizes[3] = { 257, 1, 4 };
+  static const mz_uint16 s_min_table_sizes[3] = { 257, 1, 4 };
 
   tinfl_status status = TINFL_STATUS_FAILED; mz_uint32 num_bits, dist, counter, num_extra; tinfl_bit_buf_t bit_buf;
   const mz_uint8 *pIn_buf_cur = pIn_buf_next, *const pIn_buf_end = pIn_buf_next + *pIn_buf_size;
@@ -1564,6 +1727,51 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
       for ( ; ; )
       {
         mz_uint8 *pSrc;
+
+        // Fast loop: whole literal / length / distance codes with word sized refills and none of the per-byte
+        // input and output checks; the code below finishes off the last few bytes of either buffer.
+        if (((pIn_buf_end - pIn_buf_cur) >= TINFL_FAST_INPUT_MIN) && ((pOut_buf_end - pOut_buf_cur) >= TINFL_FAST_OUTPUT_MIN))
+        {
+          do
+          {
+            mz_uint len;
+            TINFL_FAST_REFILL();
+            TINFL_FAST_DECODE(counter, &r->m_tables[0]);
+            if (counter < 256)
+            {
+              *pOut_buf_cur++ = (mz_uint8)counter;
+#if TINFL_USE_64BIT_BITBUF
+              TINFL_FAST_DECODE(counter, &r->m_tables[0]);
+              if (counter < 256) { *pOut_buf_cur++ = (mz_uint8)counter; continue; }
+#else
+              continue;
+#endif
+            }
+            if (counter == 256) break;
+            if (counter > 285) { TINFL_CR_RETURN_FOREVER(43, TINFL_STATUS_FAILED); }
+
+            num_extra = s_length_extra[counter - 257]; len = s_length_base[counter - 257];
+            if (num_extra) { len += (mz_uint)bit_buf & ((1U << num_extra) - 1); bit_buf >>= num_extra; num_bits -= num_extra; }
+
+            if (num_bits < 28) TINFL_FAST_REFILL();
+            TINFL_FAST_DECODE(dist, &r->m_tables[1]);
+            if (dist > 29) { TINFL_CR_RETURN_FOREVER(44, TINFL_STATUS_FAILED); }
+            num_extra = s_dist_extra[dist]; dist = s_dist_base[dist];
+#if !TINFL_USE_64BIT_BITBUF
+            if (num_bits < num_extra) TINFL_FAST_REFILL();
+#endif
+            if (num_extra) { dist += (mz_uint32)bit_buf & ((1U << num_extra) - 1); bit_buf >>= num_extra; num_bits -= num_extra; }
+
+            dist_from_out_buf_start = pOut_buf_cur - pOut_buf_start;
+            if ((dist > dist_from_out_buf_start) && (decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF))
+            {
+              TINFL_CR_RETURN_FOREVER(45, TINFL_STATUS_FAILED);
+            }
+            pOut_buf_cur = tinfl_copy_match(pOut_buf_cur, pOut_buf_start + ((dist_from_out_buf_start - dist) & out_buf_size_mask), len, pOut_buf_start, pOut_buf_end);
+          } while (((pIn_buf_end - pIn_buf_cur) >= TINFL_FAST_INPUT_MIN) && ((pOut_buf_end - pOut_buf_cur) >= TINFL_FAST_OUTPUT_MIN));
+          if (counter == 256) break;
+        }
+
         for ( ; ; )
         {
           if (((pIn_buf_end - pIn_buf_cur) < 4) || ((pOut_buf_end - pOut_buf_cur) < 2))
@@ -1631,7 +1839,7 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
 
         pSrc = pOut_buf_start + ((dist_from_out_buf_start - dist) & out_buf_size_mask);
 
-        if ((MZ_MAX(pOut_buf_cur, pSrc) + counter) > pOut_buf_end)
+        if ((pOut_buf_cur + counter) > pOut_buf_end)
         {
           while (counter--)
           {
@@ -1640,43 +1848,7 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
           }
           continue;
         }
-#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES
-        else if ((counter >= 9) && (counter <= dist))
-        {
-          const mz_uint8 *pSrc_end = pSrc + (counter & ~7);
-          do
-          {
-            ((mz_uint32 *)pOut_buf_cur)[0] = ((const mz_uint32 *)pSrc)[0];
-            ((mz_uint32 *)pOut_buf_cur)[1] = ((const mz_uint32 *)pSrc)[1];
-            pOut_buf_cur += 8;
-          } while ((pSrc += 8) < pSrc_end);
-          if ((counter &= 7) < 3)
-          {
-            if (counter)
-            {
-              pOut_buf_cur[0] = pSrc[0];
-              if (counter > 1)
-                pOut_buf_cur[1] = pSrc[1];
-              pOut_buf_cur += counter;
-            }
-            continue;
-          }
-        }
-#endif
-        do
-        {
-          pOut_buf_cur[0] = pSrc[0];
-          pOut_buf_cur[1] = pSrc[1];
-          pOut_buf_cur[2] = pSrc[2];
-          pOut_buf_cur += 3; pSrc += 3;
-        } while ((int)(counter -= 3) > 2);
-        if ((int)counter > 0)
-        {
-          pOut_buf_cur[0] = pSrc[0];
-          if ((int)counter > 1)
-            pOut_buf_cur[1] = pSrc[1];
-          pOut_buf_cur += counter;
-        }
+        pOut_buf_cur = tinfl_copy_match(pOut_buf_cur, pSrc, counter, pOut_buf_start, pOut_buf_end);
       }
     }
   } while (!(r->m_final & 1));
@@ -1709,6 +1881,7 @@ common_exit:
   return status;
 }
 
+#ifndef MINIZ_NO_INFLATE_HELPERS
 // Higher level helper functions.
 void *tinfl_decompress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, size_t *pOut_len, int flags)
 {
@@ -1772,6 +1945,7 @@ int tinfl_decompress_mem_to_callback(const void *pIn_buf, size_t *pIn_buf_size,
   *pIn_buf_size = in_buf_ofs;
   return result;
 }
+#endif // #ifndef MINIZ_NO_INFLATE_HELPERS
 
 #ifndef MINIZ_NO_COMPRESSION
 // ------------------- Low-level Compression (independent from all decompression API's)
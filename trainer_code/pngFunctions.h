@@ -2,84 +2,827 @@
 
 #include "pngle.h"
 
-#define LINE_BUF_SIZE 64  // pixel = 524, 16 = 406, 32 = 386, 64 = 375, 128 = 368, 240 = 367, no draw = 324 (51ms v 200ms)
-int16_t px = 0, sx = 0;
-int16_t py = 0, sy = 0;
-uint8_t pc = 0;
-uint16_t lbuf[LINE_BUF_SIZE];
+// Line buffers: pixels on their way to the target. PngRenderer carves them out of its fixed arena for every image,
+// each holding as many whole rows as fit (up to PNG_BATCH_ROWS), so opaque rows go out with one push per batch;
+// rows wider than a buffer go out in pieces. Bigger pushes kept paying off with the old fixed buffer (pixels per
+// push: 1 = 524, 16 = 406, 32 = 386, 64 = 375, 128 = 368, 240 = 367 ms, no draw = 324 ms)
+#define PNG_LINE_ARENA 2048 // pixels (4 KB) shared by all line buffers of a renderer
+#define PNG_BATCH_ROWS 8 // rows per line buffer at most, so a batch doesn't keep pixels off the screen for long
 
- int16_t png_dx = 0, png_dy = 0;
+// With USE_PNG_DMA, line buffers go out to the screen with pushImageDMA() and decoding carries on into the next
+// buffer while the SPI transfer runs. Needs TFT_eSPI's DMA support (ESP32_DMA); without it, or if initDMA() fails,
+// the blocking pushes are used as before
+#if defined(USE_LINE_BUFFER) && defined(USE_PNG_DMA) && defined(ESP32_DMA)
+#define PNG_DMA
+#if __has_include("esp_memory_utils.h")
+#include "esp_memory_utils.h" // esp_ptr_dma_capable()
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+#endif
+
+#ifdef ESP32
+#include "esp_heap_caps.h"
+#endif
+
+// Where a PngRenderer draws. push() gets RGB565 pixels in the byte order the TFT takes (big endian), fill() and
+// pixel() plain RGB565 colors. Everything drawn is inside width() x height()
+class PngTarget {
+  public:
+    virtual int32_t width() = 0;
+    virtual int32_t height() = 0;
+
+    // Around each PngLoader::step()
+    virtual void startWrite() {}
+    virtual void endWrite() {}
+
+    virtual void fill(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) = 0;
+    virtual void pixel(int32_t x, int32_t y, uint16_t color) { fill(x, y, 1, 1, color); }
+    virtual void push(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels) = 0;
+
+    // true when push() only starts sending the pixels: they must stay untouched until wait() returns
+    virtual bool async() { return false; }
+    virtual void wait() {}
+};
+
+// The screen
+class PngTftTarget : public PngTarget {
+  public:
+    PngTftTarget(TFT_eSPI &tft) : tft(tft) {}
+
+    int32_t width() { return tft.width(); }
+    int32_t height() { return tft.height(); }
+
+    void startWrite() {
+    #ifdef PNG_DMA
+      if (!dmaTried) {
+        dmaTried = true;
+        dma = tft.initDMA();
+      }
+    #endif
+      tft.startWrite(); // Crashes Adafruit_GFX
+    }
+
+    void endWrite() {
+      tft.endWrite();
+    }
+
+    void fill(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+      tft.fillRect(x, y, w, h, color);
+    }
+
+    void pixel(int32_t x, int32_t y, uint16_t color) {
+      tft.drawPixel(x, y, color);
+    }
+
+    // TFT_eSPI waits for the previous DMA transfer itself before it starts the next one. Pixels DMA can't read
+    // (PSRAM, e.g. from PngCache) go out the blocking way
+    void push(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels) {
+    #ifdef PNG_DMA
+      if (dma && esp_ptr_dma_capable(pixels)) {
+        tft.pushImageDMA(x, y, w, h, (uint16_t *)pixels);
+        return;
+      }
+    #endif
+      tft.setAddrWindow(x, y, w, h);
+      tft.pushPixels(pixels, w * h);
+    }
+
+    bool async() {
+      return dma;
+    }
+
+    void wait() {
+    #ifdef PNG_DMA
+      tft.dmaWait();
+    #endif
+    }
+
+  private:
+    TFT_eSPI &tft;
+    bool dma = false; // initDMA() succeeded
+    bool dmaTried = false;
+};
+
+// A sprite, e.g. to put an image together with other drawing before it goes to the screen. A 16 bit one stores
+// its pixels the way the TFT takes them, so pushImage() copies rows straight in; 8 bit ones convert plain RGB565
+class PngSpriteTarget : public PngTarget {
+  public:
+    PngSpriteTarget(TFT_eSprite &sprite) : sprite(sprite) {}
+
+    int32_t width() { return sprite.width(); }
+    int32_t height() { return sprite.height(); }
+
+    void fill(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+      sprite.fillRect(x, y, w, h, color);
+    }
+
+    void pixel(int32_t x, int32_t y, uint16_t color) {
+      sprite.drawPixel(x, y, color);
+    }
+
+    void push(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels) {
+      bool swap = sprite.getSwapBytes();
+      sprite.setSwapBytes(sprite.getColorDepth() != 16);
+      sprite.pushImage(x, y, w, h, (uint16_t *)pixels);
+      sprite.setSwapBytes(swap);
+    }
+
+  private:
+    TFT_eSprite &sprite;
+};
+
+// A plain w x h RGB565 buffer, row after row, in the byte order the TFT takes - tft.pushImage() sends it as it is
+class PngBufferTarget : public PngTarget {
+  public:
+    PngBufferTarget(uint16_t *buf, int16_t w, int16_t h) : buf(buf), w(w), h(h) {}
+
+    int32_t width() { return w; }
+    int32_t height() { return h; }
+
+    void fill(int32_t x, int32_t y, int32_t fw, int32_t fh, uint16_t color) {
+      color = (color << 8) | (color >> 8);
+      if (x + fw > w) fw = w - x; // interlace preview blocks are only cut at the clip rectangle
+      if (y + fh > h) fh = h - y;
+      for (int32_t j = 0; j < fh; j++) {
+        uint16_t *p = buf + (y + j) * w + x;
+        for (int32_t i = 0; i < fw; i++) p[i] = color;
+      }
+    }
+
+    void push(int32_t x, int32_t y, int32_t pw, int32_t ph, const uint16_t *pixels) {
+      for (int32_t j = 0; j < ph; j++) memcpy(buf + (y + j) * w + x, pixels + j * pw, pw * 2);
+    }
+
+  private:
+    uint16_t *buf;
+    int16_t w, h;
+};
+
+#define PNG_MIN_FILL_AREA 16 // interlace blocks at least this big (4x4) are filled as a preview, smaller ones only draw their own pixel
+
+// Draws what a pngle decoder produces into a PngTarget. All drawing state lives here and is found through
+// pngle_set_user_data(), so renderers for different targets can decode side by side (each needs its own decoder).
+// One image at a time per renderer; the settings apply to the images attach()ed after them
+class PngRenderer {
+  public:
+    PngRenderer(PngTarget &target) : target(target) {}
+
+    // Define corner position
+    void setPosition(int16_t x, int16_t y) {
+      posX = x;
+      posY = y;
+    }
+
+    // Blend over a known background color (e.g. TFT_SILVER for pages) for smooth edges
+    void setBackground(uint16_t color) {
+      bg = color;
+    }
+
+    void clearBackground() {
+      bg = -1;
+    }
+
+    // Draw at full (0), half (1), quarter (2) or eighth (3) size, e.g. for thumbnails
+    void setScale(uint8_t shift) {
+      scale = shift;
+    }
+
+    // Only draw the part inside this target rectangle, e.g. to repaint what a popup covered
+    void setClip(int16_t x, int16_t y, int16_t w, int16_t h) {
+      cx = x;
+      cy = y;
+      cw = w;
+      ch = h;
+    }
+
+    void clearClip() {
+      cw = -1;
+      ch = -1;
+    }
+
+    uint8_t getScale() {
+      return scale;
+    }
+
+    int32_t getBackground() {
+      return bg;
+    }
+
+    // Set up a decoder to draw its image here with the current settings; false if none of it would be visible
+    bool attach(pngle_t *pngle) {
+      int32_t x0, y0, x1, y1;
+      if (!visible(x0, y0, x1, y1)) return false;
+
+      // Later drawing may move the position before this image is done
+      dx = posX;
+      dy = posY;
+      finished = false;
+
+      pngle_set_user_data(pngle, this);
+      pngle_set_draw_callback(pngle, onDraw);
+      pngle_set_done_callback(pngle, onDone);
+      if (bg >= 0) {
+        // RGB565 -> RGB888, low bits filled from the top ones
+        uint8_t r = (bg >> 11) & 0x1f, g = (bg >> 5) & 0x3f, b = bg & 0x1f;
+        pngle_set_background(pngle, (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+      }
+      pngle_set_scale(pngle, scale);
+      pngle_set_clip(pngle, x0, y0, x1 - x0, y1 - y0);
+    #ifdef USE_LINE_BUFFER
+      pngle_set_init_callback(pngle, onInit);
+      pngle_set_row_callback(pngle, onRow);
+      pngle_set_output_format(pngle, PNGLE_OUTPUT_RGB565BE);
+    #endif
+      return true;
+    }
+
+    // Whether all of a w x h image would be drawn with the current settings
+    bool covers(uint32_t w, uint32_t h) {
+      int32_t x0, y0, x1, y1;
+      return visible(x0, y0, x1, y1) && x0 == 0 && y0 == 0 && x1 >= (int32_t)w && y1 >= (int32_t)h;
+    }
+
+    // Also draw the attached image into copy, at (0, 0) instead of the position; NULL = stop. Only whole images fit
+    void setCopy(PngTarget *target) {
+      copy = target;
+    }
+
+    // Draw a decoded w x h bitmap (pixels in the TFT's byte order, e.g. from PngCache) with the current settings
+    void blit(const uint16_t *bitmap, uint32_t w, uint32_t h) {
+      int32_t x0, y0, x1, y1;
+      if (!visible(x0, y0, x1, y1)) return;
+      if (x1 > (int32_t)w) x1 = w;
+      if (y1 > (int32_t)h) y1 = h;
+      if (x1 <= x0 || y1 <= y0) return;
+
+      if (x0 == 0 && x1 == (int32_t)w) {
+        target.push(posX, posY + y0, w, y1 - y0, bitmap + y0 * w);
+      } else {
+        for (int32_t y = y0; y < y1; y++) target.push(posX + x0, posY + y, x1 - x0, 1, bitmap + y * w + x0);
+      }
+      if (target.async()) target.wait();
+    }
+
+    // Image finished (or the clip rectangle is complete)
+    bool done() {
+      return finished;
+    }
+
+    // Draw any remaining pixels and wait for them, before the target is released
+    void flush() {
+    #ifdef USE_LINE_BUFFER
+      flushLine();
+    #endif
+      fence();
+    }
+
+    PngTarget &target;
+
+  private:
+    // The target and the requested clip rectangle, converted to image coordinates; false if that is empty
+    bool visible(int32_t &x0, int32_t &y0, int32_t &x1, int32_t &y1) {
+      x0 = 0; y0 = 0; x1 = target.width(); y1 = target.height();
+      if (cw >= 0) {
+        if (cx > x0) x0 = cx;
+        if (cy > y0) y0 = cy;
+        if (cx + cw < x1) x1 = cx + cw;
+        if (cy + ch < y1) y1 = cy + ch;
+      }
+      x0 -= posX; x1 -= posX; if (x0 < 0) x0 = 0;
+      y0 -= posY; y1 -= posY; if (y0 < 0) y0 = 0;
+      return x1 > x0 && y1 > y0;
+    }
+
+    static PngRenderer *of(pngle_t *pngle) {
+      return (PngRenderer *)pngle_get_user_data(pngle);
+    }
+
+    static void onDraw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4]) {
+      of(pngle)->draw(pngle, x, y, w, h, rgba);
+    }
+
+    static void onDone(pngle_t *pngle) {
+      of(pngle)->finished = true;
+    }
+
+    // Wait for the transfer in flight, before a blocking draw, endWrite() or touching its pixels
+    void fence() {
+      if (inFlight) {
+        target.wait();
+        inFlight = NULL;
+      }
+    }
+
+    // Draw pixel
+    void draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4]) {
+      uint16_t color = (rgba[0] << 8 & 0xf800) | (rgba[1] << 3 & 0x07e0) | (rgba[2] >> 3 & 0x001f);
+
+      // Early Adam7 passes: one fill per block gives a coarse preview that later passes refine.
+      // Opaque images only - a transparent pixel of a later pass would leave the preview color behind
+      if (w * h >= PNG_MIN_FILL_AREA && pngle_is_opaque(pngle)) {
+        flush();
+        target.fill(dx + x, dy + y, w, h, color);
+        if (copy) copy->fill(x, y, w, h, color);
+        return;
+      }
+
+    #ifdef USE_LINE_BUFFER
+      color = (color << 8) | (color >> 8);
+    #endif
+      if (rgba[3] > 127) { // Transparency threshold (setBackground() blends instead)
+
+      #ifdef USE_LINE_BUFFER // This must handle skipped pixels in transparent PNGs
+        if ( pc >= lbufSize) {
+          flushLine();
+          px = x; sx = x; sy = y;
+        }
+
+        if ( pc && !pw && (x == px) && (sy == y) && (pc < lbufSize) ) {px++; lbuf[pc++] = color;}
+        else {
+          flushLine();
+          px = x; sx = x; sy = y;
+          px++; lbuf[pc++] = color;
+        }
+      #else
+        target.pixel(dx + x, dy + y, color);
+        if (copy) copy->pixel(x, y, color);
+      #endif
+      }
+    }
+
+  #ifdef USE_LINE_BUFFER
+    static void onInit(pngle_t *pngle, uint32_t w, uint32_t h) {
+      of(pngle)->init(w, h);
+    }
+
+    static void onRow(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const void *pixels) {
+      of(pngle)->row(pngle, x, y, n, (const uint16_t *)pixels);
+    }
+
+    // Image size known. Line buffers become whole rows of this image (w is after setScale())
+    void init(uint32_t w, uint32_t h) {
+      fence(); // the arena is carved up anew
+      lbufs = target.async() ? 2 : 1; // one being filled, the other on its way out
+
+      uint32_t room = PNG_LINE_ARENA / lbufs;
+      uint32_t rows = w ? room / w : 0;
+      if (rows > PNG_BATCH_ROWS) rows = PNG_BATCH_ROWS;
+      if (rows > h) rows = h;
+
+      lbufSize = rows ? rows * w : room;
+      lbufIndex = 0;
+      lbuf = arena;
+      pc = 0;
+      pw = 0;
+    }
+
+    // Draw a whole scanline of TFT-ready RGB565 pixels
+    void row(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const uint16_t *pixels) {
+      const uint8_t *mask = pngle_get_row_mask(pngle);
+
+      // Opaque image - whole rows go out in batches
+      if (!mask) {
+        addRow(x, y, n, pixels);
+        return;
+      }
+
+      // Push whatever is left from an earlier row or interlace pass
+      flushLine();
+
+      uint32_t i = 0;
+      while (i < n) {
+        // Skip transparent pixels, then push the opaque run that follows
+        while (i < n && !(mask[i >> 3] & (0x80 >> (i & 7)))) i++;
+        uint32_t start = i;
+        while (i < n &&  (mask[i >> 3] & (0x80 >> (i & 7)))) i++;
+
+        if (i > start) pushRun(dx + x + start, dy + y, i - start, pixels + start);
+      }
+    }
+
+    // Send a w x h block of pixels to (x, y) of the target. An async target must not see them change before fence()
+    void push(int32_t x, int32_t y, uint32_t w, uint32_t h, const uint16_t *pixels) {
+      target.push(x, y, w, h, pixels);
+      if (target.async()) inFlight = pixels;
+      if (copy) copy->push(x - dx, y - dy, w, h, pixels);
+    }
+
+    // Move on to the next line buffer after pushing this one, waiting for it if it is still going out
+    void nextLbuf() {
+      lbufIndex = (lbufIndex + 1) % lbufs;
+      lbuf = arena + lbufIndex * lbufSize;
+      if (lbuf == inFlight) fence();
+    }
+
+    // Push the pixels gathered in lbuf
+    void flushLine() {
+      if (!pc) return;
+      if (pw) push(dx + sx, dy + sy, pw, pc / pw, lbuf);
+      else push(dx + sx, dy + sy, pc, 1, lbuf);
+      nextLbuf();
+      pc = 0;
+      pw = 0;
+    }
+
+    // Push a run of pixels that pngle overwrites with the next row; an async target gets a copy in the line buffers
+    void pushRun(int32_t x, int32_t y, uint32_t n, const uint16_t *pixels) {
+      if (!target.async()) {
+        push(x, y, n, 1, pixels);
+        return;
+      }
+      while (n) {
+        uint32_t k = n < lbufSize ? n : lbufSize;
+        memcpy(lbuf, pixels, k * 2);
+        push(x, y, k, 1, lbuf);
+        nextLbuf();
+        x += k; pixels += k; n -= k;
+      }
+    }
+
+    // Queue a row of opaque pixels; rows below each other with the same span are pushed together as one block
+    void addRow(int32_t x, int32_t y, uint32_t n, const uint16_t *pixels) {
+      if (n > lbufSize) {
+        flushLine();
+        pushRun(dx + x, dy + y, n, pixels);
+        return;
+      }
+
+      if (pc && !(pw == n && sx == x && sy + pc / pw == y && pc + n <= lbufSize)) flushLine();
+      if (!pc) {
+        sx = x;
+        sy = y;
+        pw = n;
+      }
+      memcpy(lbuf + pc, pixels, n * 2);
+      pc += n;
+      if (pc + n > lbufSize) flushLine(); // no room for another one
+    }
+
+    uint16_t arena[PNG_LINE_ARENA]; // a global renderer keeps it in DMA capable memory
+    uint16_t lbufSize = PNG_LINE_ARENA; // pixels per line buffer
+    uint8_t lbufs = 1; // line buffers in the arena
+    uint8_t lbufIndex = 0; // the one being filled
+    uint16_t *lbuf = arena;
+    int16_t px = 0, sx = 0, sy = 0;
+    uint16_t pc = 0; // pixels in lbuf
+    uint16_t pw = 0; // lbuf holds pc / pw whole rows pw wide from (sx, sy), 0 = a run of pixels on row sy
+  #endif
+
+    const uint16_t *inFlight = NULL; // pixels of the transfer in flight, must not be touched until fence()
+    PngTarget *copy = NULL;
+    int16_t posX = 0, posY = 0; // for the next images
+    int16_t dx = 0, dy = 0; // for this one
+    int16_t cx = 0, cy = 0, cw = -1, ch = -1; // clip rectangle, width < 0 = none
+    int32_t bg = -1; // RGB565 color transparent pixels are blended over, < 0 = transparency threshold only
+    uint8_t scale = 0; // draw at 1 / (1 << scale) size
+    bool finished = false;
+};
+
+// The screen, drawn by load_file() and PngLoader unless told otherwise
+PngTftTarget pngScreen(tft);
+PngRenderer pngRenderer(pngScreen);
 
 // Define corner position
 void setPngPosition(int16_t x, int16_t y)
 {
-  png_dx = x;
-  png_dy = y;
+  pngRenderer.setPosition(x, y);
+}
+
+// Blend the next images over a known background color (e.g. TFT_SILVER for pages) for smooth edges
+void setPngBackground(uint16_t color)
+{
+  pngRenderer.setBackground(color);
+}
+
+void clearPngBackground()
+{
+  pngRenderer.clearBackground();
+}
+
+// Draw the next images at full (0), half (1), quarter (2) or eighth (3) size, e.g. for thumbnails
+void setPngScale(uint8_t shift)
+{
+  pngRenderer.setScale(shift);
 }
 
-// Draw pixel - called by pngle
-void pngle_on_draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4])
+// Only draw the part of the next images inside this screen rectangle, e.g. to repaint what a popup covered
+void setPngClip(int16_t x, int16_t y, int16_t w, int16_t h)
 {
-  uint16_t color = (rgba[0] << 8 & 0xf800) | (rgba[1] << 3 & 0x07e0) | (rgba[2] >> 3 & 0x001f);
-#ifdef USE_LINE_BUFFER
-  color = (color << 8) | (color >> 8);
+  pngRenderer.setClip(x, y, w, h);
+}
+
+void clearPngClip()
+{
+  pngRenderer.clearClip();
+}
+
+#ifndef PNG_CACHE_BYTES
+#define PNG_CACHE_BYTES 0 // decoded images kept by pngCache (in PSRAM when there is some), 0 = none
 #endif
-  if (rgba[3] > 127) { // Transparency threshold (no blending yet...)
+#define PNG_CACHE_ENTRIES 8 // most images kept at a time
+
+// Decoded images, so drawing one again is a single push instead of inflating it again. Keyed by the asset and
+// the settings that change its pixels (scale, background); the least recently used ones make room for new ones.
+// Only images that were drawn whole and came out opaque (or blended over a background) are kept.
+// hits / misses count find() results, to size the budget from
+class PngCache {
+  public:
+    PngCache(uint32_t budget) : budget(budget) {}
 
-  #ifdef USE_LINE_BUFFER // This must handle skipped pixels in transparent PNGs
-    if ( pc >= LINE_BUF_SIZE) {
-      tft.pushImage(png_dx + sx, png_dy + sy, LINE_BUF_SIZE, 1, lbuf);
-      px = x; sx = x; sy = y; pc = 0;
+    // The bitmap of an asset (pixels in the TFT's byte order), or NULL
+    const uint16_t *find(const uint8_t *data, uint8_t scale, int32_t bg, uint16_t &w, uint16_t &h) {
+      for (int i = 0; i < PNG_CACHE_ENTRIES; i++) {
+        Entry &e = entries[i];
+        if (e.ready && e.data == data && e.scale == scale && e.bg == bg) {
+          e.used = ++clock;
+          w = e.w;
+          h = e.h;
+          hits++;
+          return e.bitmap;
+        }
+      }
+      misses++;
+      return NULL;
     }
 
-    if ( (x == px) && (sy == y) && (pc < LINE_BUF_SIZE) ) {px++; lbuf[pc++] = color;}
-    else {
-      tft.pushImage(png_dx + sx, png_dy + sy, pc, 1, lbuf);
-      px = x; sx = x; sy = y; pc = 0;
-      px++; lbuf[pc++] = color;
+    // Room for the w x h bitmap of an asset, made by dropping the least recently used ones; NULL if it can't fit.
+    // find() returns it once commit() says it is complete
+    uint16_t *reserve(const uint8_t *data, uint8_t scale, int32_t bg, uint16_t w, uint16_t h) {
+      uint32_t bytes = (uint32_t)w * h * 2;
+      if (!bytes || bytes > budget) return NULL;
+
+      Entry *slot = NULL;
+      for (;;) {
+        if (!slot) {
+          for (int i = 0; i < PNG_CACHE_ENTRIES && !slot; i++) {
+            if (!entries[i].bitmap) slot = &entries[i];
+          }
+        }
+        if (slot && size + bytes <= budget) break;
+        if (!evict()) return NULL;
+      }
+
+      uint16_t *bitmap = (uint16_t *)alloc(bytes);
+      if (!bitmap) return NULL;
+      *slot = { data, bitmap, 0, bg, w, h, scale, false };
+      size += bytes;
+      return bitmap;
     }
-  #else
-    tft.drawPixel(x, y, color);
-  #endif
-  }
+
+    // The bitmap from reserve() is complete
+    void commit(uint16_t *bitmap) {
+      Entry *e = entry(bitmap);
+      if (!e) return;
+      e->ready = true;
+      e->used = ++clock;
+    }
+
+    // Give back a bitmap from reserve(), e.g. when its image failed
+    void drop(uint16_t *bitmap) {
+      Entry *e = entry(bitmap);
+      if (e) release(*e);
+    }
+
+    void clear() {
+      for (int i = 0; i < PNG_CACHE_ENTRIES; i++) {
+        if (entries[i].ready) release(entries[i]);
+      }
+    }
+
+    // Bytes of bitmaps held
+    uint32_t bytes() {
+      return size;
+    }
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+
+  private:
+    struct Entry {
+      const uint8_t *data; // asset
+      uint16_t *bitmap; // NULL = free slot
+      uint32_t used; // clock of the last find()
+      int32_t bg;
+      uint16_t w, h;
+      uint8_t scale;
+      bool ready; // false while it is being drawn
+    };
+
+    static void *alloc(uint32_t bytes) {
+    #ifdef ESP32
+      void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+      if (p) return p;
+    #endif
+      return malloc(bytes);
+    }
+
+    Entry *entry(uint16_t *bitmap) {
+      for (int i = 0; i < PNG_CACHE_ENTRIES; i++) {
+        if (bitmap && entries[i].bitmap == bitmap) return &entries[i];
+      }
+      return NULL;
+    }
+
+    void release(Entry &e) {
+      size -= (uint32_t)e.w * e.h * 2;
+      free(e.bitmap);
+      e.bitmap = NULL;
+      e.ready = false;
+    }
+
+    // Drop the least recently used complete bitmap; false if there is none
+    bool evict() {
+      Entry *lru = NULL;
+      for (int i = 0; i < PNG_CACHE_ENTRIES; i++) {
+        if (entries[i].ready && (!lru || entries[i].used < lru->used)) lru = &entries[i];
+      }
+      if (!lru) return false;
+      release(*lru);
+      evictions++;
+      return true;
+    }
+
+    Entry entries[PNG_CACHE_ENTRIES] = {};
+    uint32_t budget;
+    uint32_t size = 0;
+    uint32_t clock = 0;
+};
+
+PngCache pngCache(PNG_CACHE_BYTES);
+
+#define PNG_FEED_SLICE 256 // bytes handed to pngle_feed() at a time by a budgeted PngLoader::step(), bounds how far it overruns
+
+// Draws a FLASH array a slice at a time, so the caller's loop keeps polling inputs in between.
+// Flash is memory-mapped on the ESP32, so pngle reads the array in place: no staging copy or tail memmove
+class PngLoader {
+  public:
+    PngLoader(PngRenderer &renderer = pngRenderer, PngCache *cache = &pngCache) : renderer(&renderer), cache(cache) {}
+
+    // Start an image with the renderer's current settings (setPngPosition() / setPngClip() / ... for the screen).
+    // trusted = generated by tools/png_to_header.py, which already checked the CRCs.
+    // Returns false when there is nothing to step through: nothing visible, an error, or drawn from the cache
+    bool begin(const uint8_t* arrayData, uint32_t arraySize, bool trusted = false) {
+      cancel();
+
+      uint8_t scale = renderer->getScale();
+      int32_t bg = renderer->getBackground();
+      if (cache) {
+        uint16_t w, h;
+        const uint16_t *bitmap = cache->find(arrayData, scale, bg, w, h);
+        if (bitmap) {
+          renderer->target.startWrite();
+          renderer->blit(bitmap, w, h);
+          renderer->target.endWrite();
+          return false;
+        }
+      }
+
+      // Static decoder context, reused for every image instead of a ~43 KB pngle_new() per page switch
+      pngle = pngle_pool_acquire();
+      if (!pngle) {
+        Serial.printf("ERROR: %s\n", "No free PNG decoder");
+        return false;
+      }
+      pngle_set_trusted(pngle, trusted);
+      if (!renderer->attach(pngle)) {
+        cancel();
+        return false;
+      }
+
+      // Keep a copy for next time if it is drawn whole
+      uint32_t w, h;
+      if (cache && pngSize(arrayData, arraySize, w, h)) {
+        w = (w + (1 << scale) - 1) >> scale;
+        h = (h + (1 << scale) - 1) >> scale;
+        if (w <= INT16_MAX && h <= INT16_MAX && renderer->covers(w, h)) {
+          copyBitmap = cache->reserve(arrayData, scale, bg, w, h);
+          if (copyBitmap) {
+            copy = PngBufferTarget(copyBitmap, w, h);
+            renderer->setCopy(&copy);
+          }
+        }
+      }
+
+      data = arrayData;
+      size = arraySize;
+      index = 0;
+      return true;
+    }
+
+    // Decode for about budgetUs microseconds; returns true while there is more to draw
+    bool step(uint32_t budgetUs) {
+      if (!pngle) return false;
+
+      uint32_t start = micros();
+      bool failed = false;
+
+      renderer->target.startWrite();
+      do {
+        // Without a budget the whole array goes in with one call
+        uint32_t span = size - index;
+        if (budgetUs != UINT32_MAX && span > PNG_FEED_SLICE) span = PNG_FEED_SLICE;
+        int fed = pngle_feed(pngle, data + index, span);
+        if (fed < 0) {
+          Serial.printf("ERROR: %s\n", pngle_error(pngle));
+          failed = true;
+          break;
+        }
+        if (fed == 0) { // data ended mid-chunk
+          Serial.printf("ERROR: %s\n", "Truncated PNG");
+          failed = true;
+          break;
+        }
+        index += fed; // a chunk header cut off at the end of the span is fed again next time
+      } while (!renderer->done() && index < size && micros() - start < budgetUs);
+      // Draw any remaining pixels - the next step may be a while away, and others draw in between
+      renderer->flush();
+      renderer->target.endWrite();
+
+      if (failed || renderer->done() || index >= size) {
+        finish(!failed && renderer->done());
+        return false;
+      }
+      return true;
+    }
+
+    // Draw the images that follow with another renderer, e.g. one on a sprite; drops the current image
+    void setRenderer(PngRenderer &renderer) {
+      cancel();
+      this->renderer = &renderer;
+    }
+
+    bool busy() {
+      return pngle != NULL;
+    }
+
+    // Drop the rest of the image, e.g. when its page is closed
+    void cancel() {
+      if (copyBitmap) {
+        renderer->setCopy(NULL);
+        cache->drop(copyBitmap);
+        copyBitmap = NULL;
+      }
+      if (!pngle) return;
+      pngle_pool_release(pngle);
+      pngle = NULL;
+    }
+
+  private:
+    // Image size from the IHDR chunk at the start of a PNG
+    static bool pngSize(const uint8_t *data, uint32_t size, uint32_t &w, uint32_t &h) {
+      static const uint8_t head[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+      if (size < 24 || memcmp(data, head, sizeof(head))) return false;
+      w = (uint32_t)data[16] << 24 | data[17] << 16 | data[18] << 8 | data[19];
+      h = (uint32_t)data[20] << 24 | data[21] << 16 | data[22] << 8 | data[23];
+      return w && h;
+    }
+
+    void finish(bool complete) {
+      // Keep the copy if all of it was drawn and nothing showed through
+      if (copyBitmap && complete && pngle_is_opaque(pngle)) {
+        renderer->setCopy(NULL);
+        cache->commit(copyBitmap);
+        copyBitmap = NULL;
+      }
+
+      // Where the time went, when pngle.c is built with PNGLE_STATS
+      const pngle_stats_t *st = pngle_get_stats(pngle);
+      if (st) {
+        Serial.printf("PNG: fed %lu B, inflated %lu B, %lu rows, %lu px, %lu calls | cycles: inflate %lu, unfilter %lu, draw %lu\n",
+          (unsigned long)st->bytes_fed, (unsigned long)st->bytes_inflated, (unsigned long)st->rows_unfiltered,
+          (unsigned long)st->pixels_emitted, (unsigned long)st->callbacks,
+          (unsigned long)st->cycles_inflate, (unsigned long)st->cycles_unfilter, (unsigned long)st->cycles_draw);
+        if (cache) {
+          Serial.printf("PNG cache: %lu hits, %lu misses, %lu evictions, %lu B held\n", (unsigned long)cache->hits,
+            (unsigned long)cache->misses, (unsigned long)cache->evictions, (unsigned long)cache->bytes());
+        }
+      }
+
+      cancel();
+    }
+
+    PngRenderer *renderer;
+    PngCache *cache;
+    uint16_t *copyBitmap = NULL; // reserved in the cache for this image
+    PngBufferTarget copy = PngBufferTarget(NULL, 0, 0);
+    pngle_t *pngle = NULL;
+    const uint8_t *data = NULL;
+    uint32_t size = 0;
+    uint32_t index = 0;
+};
+
+// Render from FLASH array in one go with a renderer of its own, e.g. into a sprite
+void load_file(PngRenderer &renderer, const uint8_t* arrayData, uint32_t arraySize, bool trusted = false)
+{
+  PngLoader loader(renderer);
+  if (!loader.begin(arrayData, arraySize, trusted)) return;
+  while (loader.step(UINT32_MAX));
 }
 
-// Render from FLASH array
-void load_file(const uint8_t* arrayData, uint32_t arraySize)
+// Render from FLASH array in one go; trusted = generated by tools/png_to_header.py, which already checked the CRCs
+void load_file(const uint8_t* arrayData, uint32_t arraySize, bool trusted = false)
 {
-  pngle_t *pngle = pngle_new();
-  pngle_set_draw_callback(pngle, pngle_on_draw);
-
-  // Feed data to pngle
-  uint8_t buf[1024];
-
-  uint32_t remain = 0;
-  uint32_t arrayIndex = 0;
-  uint32_t avail  = arraySize;
-  uint32_t take = 0;
-
-  tft.startWrite(); // Crashes Adafruit_GFX
-  while ( avail > 0 ) {
-    avail = arraySize - arrayIndex;
-    take = sizeof(buf) - remain; if (take > avail) take = avail;
-    memcpy_P(buf + remain, (const uint8_t *)(arrayData + arrayIndex), take);
-    arrayIndex += take;
-    remain += take;
-    int fed = pngle_feed(pngle, buf, remain);
-    if (fed < 0) {
-      Serial.printf("ERROR: %s\n", pngle_error(pngle));
-      break;
-    }
-    remain = remain - fed;
-    if (remain > 0) memmove(buf, buf + fed, remain);
-  }
-#ifdef USE_LINE_BUFFER
-   // Draw any remaining pixels - had no warning that image has ended...
-  if (pc) {
-    tft.pushImage(png_dx + sx, png_dy + sy, pc, 1, lbuf);
-    pc = 0;
-  }
-#endif
-  tft.endWrite();
-  pngle_destroy(pngle);
+  load_file(pngRenderer, arrayData, arraySize, trusted);
 }
@@ -22,6 +22,8 @@
  * SOFTWARE.
  */
 //#define PNGLE_NO_GAMMA_CORRECTION
+#define PNGLE_ARENA_SIZE 8192 // per-image buffers come from a fixed arena inside pngle_t; comment out to use calloc()
+//#define PNGLE_STATS // count bytes / rows / pixels and the cycles spent per stage, see pngle_get_stats()
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -43,9 +45,41 @@
 
 #define PNGLE_ERROR(s) (pngle->error = (s), pngle->state = PNGLE_STATE_ERROR, -1)
 #define PNGLE_CALLOC(a, b, name) (debug_printf("[pngle] Allocating %zu bytes for %s\n", (size_t)(a) * (size_t)(b), (name)), calloc((size_t)(a), (size_t)(b)))
+#define PNGLE_ALLOC(a, b, name) pngle_alloc(pngle, (size_t)(a), (size_t)(b), (name)) // per-image buffers
+#define PNGLE_FREE(p) pngle_free(pngle, (p))
+
+#ifndef PNGLE_POOL_SIZE
+#define PNGLE_POOL_SIZE 1 // number of statically allocated contexts handed out by pngle_pool_acquire()
+#endif
 
 #define PNGLE_UNUSED(x) (void)(x)
 
+#ifdef PNGLE_STATS
+#if defined(__XTENSA__)
+static inline uint32_t pngle_cycles(void) { uint32_t c; __asm__ __volatile__("rsr %0, ccount" : "=a"(c)); return c; }
+#else
+#include <time.h>
+#ifdef CLOCK_MONOTONIC
+static inline uint32_t pngle_cycles(void) { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return (uint32_t)ts.tv_sec * 1000000000u + (uint32_t)ts.tv_nsec; } // nanoseconds on POSIX hosts
+#else
+static inline uint32_t pngle_cycles(void) { return (uint32_t)clock(); } // clock() ticks elsewhere
+#endif
+#endif
+#define PNGLE_STATS_ADD(field, v) (pngle->stats.field += (v))
+#define PNGLE_STATS_BEGIN(t) uint32_t t = pngle_cycles()
+#define PNGLE_STATS_END(t, field) (pngle->stats.field += pngle_cycles() - (t))
+#else
+#define PNGLE_STATS_ADD(field, v) ((void)0)
+#define PNGLE_STATS_BEGIN(t) ((void)0)
+#define PNGLE_STATS_END(t, field) ((void)0)
+#endif
+
+#ifdef __GNUC__
+#define PNGLE_INLINE static inline __attribute__((always_inline))
+#else
+#define PNGLE_INLINE static inline
+#endif
+
 typedef enum {
   PNGLE_STATE_ERROR = -2,
   PNGLE_STATE_EOF = -1,
@@ -68,6 +102,9 @@ typedef enum {
   PNGLE_CHUNK_gAMA = 0x67414d41UL, // gAMA
 } pngle_chunk_t;
 
+// Row decode kernel: unfiltered scanline -> row_buf (see select_kernels())
+typedef int (*pngle_kernel_t)(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst);
+
 // typedef struct _pngle_t pngle_t; // declared in pngle.h
 struct _pngle_t {
   pngle_ihdr_t hdr;
@@ -81,27 +118,57 @@ struct _pngle_t {
   // tRNS chunk
   size_t n_trans_palettes;
   uint8_t *trans_palette;
+  int32_t trans_key[3]; // tRNS color for color type 0 and 2, -1 if none
+
+  // palette lookup (color type 3, built on the first IDAT)
+  uint8_t *lut_rgba8888; // 256 * 4
+  uint16_t *lut_rgb565be; // 256, stored high byte first
+  uint8_t *lut_opaque; // 256, 1 if alpha > 127
 
   // parser state (reset on every chunk header)
   pngle_state_t state;
   uint32_t chunk_type;
   uint32_t chunk_remain;
   mz_ulong crc32;
+  int trusted; // skip CRC checks (pngle_set_trusted())
 
   // decompression state (reset on IHDR)
   tinfl_decompressor inflator; // 11000 bytes
   uint8_t lz_buf[TINFL_LZ_DICT_SIZE]; // 32768 bytes
   uint8_t *next_out; // NULL indicates IDAT hasn't been processed yet
+  uint8_t *read_out; // first byte of lz_buf not yet handed to pngle_on_data()
   size_t  avail_out;
 
   // scanline decoder (reset on every set_interlace_pass() call)
-  uint8_t *scanline_ringbuf;
-  size_t scanline_ringbuf_size;
-  size_t scanline_ringbuf_cidx;
-  int_fast8_t scanline_remain_bytes_to_render;
+  uint8_t *scanline_buf; // room for two full-width scanlines (allocated on IHDR)
+  uint8_t *scanline_cur; // current scanline; filtered while being filled, unfiltered in place when complete
+  uint8_t *scanline_prev; // previous unfiltered scanline of the same pass, zeros on the first one
+  size_t scanline_idx;
   int_fast8_t filter_type;
-  uint32_t drawing_x;
   uint32_t drawing_y;
+  size_t scanline_stride;
+  uint32_t scanline_pixels;
+
+  // row output (allocated on IHDR)
+  pngle_output_format_t output_format;
+  uint8_t *row_buf; // rgba, hdr.width * 4 bytes (RGB565BE uses the first half)
+  uint8_t *row_mask; // RGB565BE only: 1 bit per pixel, MSB first, set when opaque
+  pngle_kernel_t kernel_rgba8888;
+  pngle_kernel_t kernel_rgb565be;
+
+  // background compositing (pngle_set_background())
+  int blend_enabled;
+  uint8_t blend_bg[3];
+  uint16_t *blend_lut; // [3][256]: background share bg * (255 - alpha) per channel, built on the first IDAT
+
+  // downscaled output (pngle_set_scale()), 1 / (1 << scale_shift)
+  uint_fast8_t scale_shift;
+  uint32_t *scale_acc; // non-interlaced: per output pixel sum(r * a), sum(g * a), sum(b * a), sum(a) of the current block row
+
+  // clip rectangle in output coordinates, x1 / y1 exclusive (pngle_set_clip())
+  int clip_enabled;
+  uint32_t clip_x0, clip_y0;
+  uint32_t clip_x1, clip_y1;
 
   // interlace
   uint_fast8_t interlace_pass;
@@ -109,15 +176,28 @@ struct _pngle_t {
   const char *error;
 
 #ifndef PNGLE_NO_GAMMA_CORRECTION
-  uint8_t *gamma_table;
+  const uint8_t *gamma_table; // 256 entries indexed by the 8-bit sample, NULL when no correction is needed
+  uint16_t *gamma_steps; // 16-bit samples instead: smallest sample value giving each output level
+  uint8_t *gamma_buf; // gamma_table when it had to be computed
   double display_gamma;
 #endif
 
   pngle_init_callback_t init_callback;
   pngle_draw_callback_t draw_callback;
+  pngle_row_callback_t row_callback;
   pngle_done_callback_t done_callback;
 
   void *user_data;
+
+#ifdef PNGLE_STATS
+  pngle_stats_t stats; // cleared on pngle_reset()
+#endif
+
+#ifdef PNGLE_ARENA_SIZE
+  // per-image buffers (scanlines, row output, palettes, gamma table), rewound on pngle_reset()
+  size_t arena_used;
+  uint8_t arena[PNGLE_ARENA_SIZE];
+#endif
 };
 
 // magic
@@ -151,6 +231,39 @@ static inline uint32_t U32_CLAMP_ADD(uint32_t a, uint32_t b, uint32_t top)
 }
 
 
+static void *pngle_alloc(pngle_t *pngle, size_t a, size_t b, const char *name)
+{
+  PNGLE_UNUSED(name);
+#ifdef PNGLE_ARENA_SIZE
+  if (b == 0 || a <= PNGLE_ARENA_SIZE / b) {
+    size_t size = (a * b + 3) & ~(size_t)3;
+    if (size <= PNGLE_ARENA_SIZE - pngle->arena_used) {
+      debug_printf("[pngle] Allocating %zu bytes for %s from arena (%zu / %d used)\n", a * b, name, pngle->arena_used, PNGLE_ARENA_SIZE);
+
+      void *p = pngle->arena + pngle->arena_used;
+      pngle->arena_used += size;
+      memset(p, 0, size);
+      return p;
+    }
+  }
+  // too big for what is left of the arena (e.g. a 16-bit gamma table), fall back to the heap
+#else
+  PNGLE_UNUSED(pngle);
+#endif
+  return PNGLE_CALLOC(a, b, name);
+}
+
+static void pngle_free(pngle_t *pngle, void *p)
+{
+#ifdef PNGLE_ARENA_SIZE
+  // arena memory is released all at once by pngle_reset()
+  if ((uint8_t *)p >= pngle->arena && (uint8_t *)p < pngle->arena + PNGLE_ARENA_SIZE) return ;
+#else
+  PNGLE_UNUSED(pngle);
+#endif
+  free(p);
+}
+
 void pngle_reset(pngle_t *pngle)
 {
   if (!pngle) return ;
@@ -158,18 +271,40 @@ void pngle_reset(pngle_t *pngle)
   pngle->state = PNGLE_STATE_INITIAL;
   pngle->error = "No error";
 
-  if (pngle->scanline_ringbuf) free(pngle->scanline_ringbuf);
-  if (pngle->palette) free(pngle->palette);
-  if (pngle->trans_palette) free(pngle->trans_palette);
+  if (pngle->scanline_buf) PNGLE_FREE(pngle->scanline_buf);
+  if (pngle->row_buf) PNGLE_FREE(pngle->row_buf);
+  if (pngle->row_mask) PNGLE_FREE(pngle->row_mask);
+  if (pngle->palette) PNGLE_FREE(pngle->palette);
+  if (pngle->trans_palette) PNGLE_FREE(pngle->trans_palette);
+  if (pngle->lut_rgba8888) PNGLE_FREE(pngle->lut_rgba8888);
+  if (pngle->lut_rgb565be) PNGLE_FREE(pngle->lut_rgb565be);
+  if (pngle->lut_opaque) PNGLE_FREE(pngle->lut_opaque);
+  if (pngle->scale_acc) PNGLE_FREE(pngle->scale_acc);
+  if (pngle->blend_lut) PNGLE_FREE(pngle->blend_lut);
 #ifndef PNGLE_NO_GAMMA_CORRECTION
-  if (pngle->gamma_table) free(pngle->gamma_table);
+  if (pngle->gamma_buf) PNGLE_FREE(pngle->gamma_buf);
+  if (pngle->gamma_steps) PNGLE_FREE(pngle->gamma_steps);
+#endif
+#ifdef PNGLE_ARENA_SIZE
+  pngle->arena_used = 0;
 #endif
 
-  pngle->scanline_ringbuf = NULL;
+  pngle->scanline_buf = NULL;
+  pngle->scanline_cur = NULL;
+  pngle->scanline_prev = NULL;
+  pngle->row_buf = NULL;
+  pngle->row_mask = NULL;
   pngle->palette = NULL;
   pngle->trans_palette = NULL;
+  pngle->lut_rgba8888 = NULL;
+  pngle->lut_rgb565be = NULL;
+  pngle->lut_opaque = NULL;
+  pngle->scale_acc = NULL;
+  pngle->blend_lut = NULL;
 #ifndef PNGLE_NO_GAMMA_CORRECTION
   pngle->gamma_table = NULL;
+  pngle->gamma_steps = NULL;
+  pngle->gamma_buf = NULL;
 #endif
 
   pngle->channels = 0; // indicates IHDR hasn't been processed yet
@@ -181,6 +316,10 @@ void pngle_reset(pngle_t *pngle)
   pngle->n_trans_palettes = 0;
 
   tinfl_init(&pngle->inflator);
+
+#ifdef PNGLE_STATS
+  memset(&pngle->stats, 0, sizeof(pngle->stats));
+#endif
 }
 
 pngle_t *pngle_new()
@@ -193,8 +332,70 @@ pngle_t *pngle_new()
   return pngle;
 }
 
+// ------------
+// Decoder pool
+// ------------
+// Contexts that live for the whole program. Each one embeds the 32 KB LZ
+// dictionary and the inflator, so handing them out instead of pngle_new()
+// keeps those ~43 KB off the heap; with PNGLE_ARENA_SIZE defined, decoding
+// an image then does no heap allocation at all.
+static pngle_t pngle_pool[PNGLE_POOL_SIZE];
+static uint8_t pngle_pool_in_use[PNGLE_POOL_SIZE];
+
+static int pngle_pool_index(pngle_t *pngle)
+{
+  for (int i = 0; i < PNGLE_POOL_SIZE; i++) {
+    if (pngle == &pngle_pool[i]) return i;
+  }
+  return -1;
+}
+
+pngle_t *pngle_pool_acquire()
+{
+  for (int i = 0; i < PNGLE_POOL_SIZE; i++) {
+    if (pngle_pool_in_use[i]) continue;
+
+    pngle_t *pngle = &pngle_pool[i];
+    pngle_pool_in_use[i] = 1;
+    pngle_reset(pngle);
+
+    // forget the settings of the previous user
+    pngle->init_callback = NULL;
+    pngle->draw_callback = NULL;
+    pngle->row_callback = NULL;
+    pngle->done_callback = NULL;
+    pngle->output_format = PNGLE_OUTPUT_RGBA8888;
+    pngle->trusted = 0;
+    pngle->blend_enabled = 0;
+    pngle->scale_shift = 0;
+    pngle->clip_enabled = 0;
+    pngle->user_data = NULL;
+#ifndef PNGLE_NO_GAMMA_CORRECTION
+    pngle->display_gamma = 0;
+#endif
+
+    return pngle;
+  }
+
+  return NULL; // all in use
+}
+
+void pngle_pool_release(pngle_t *pngle)
+{
+  int i = pngle_pool_index(pngle);
+  if (i < 0) return ;
+
+  pngle_reset(pngle); // drops any heap buffers right away
+  pngle_pool_in_use[i] = 0;
+}
+
 void pngle_destroy(pngle_t *pngle)
 {
+  if (pngle_pool_index(pngle) >= 0) {
+    pngle_pool_release(pngle);
+    return ;
+  }
+
   if (pngle) {
     pngle_reset(pngle);
     free(pngle);
@@ -237,13 +438,7 @@ static int is_trans_color(pngle_t *pngle, uint16_t *value, size_t n)
   return 1; // true
 }
 
-static inline void scanline_ringbuf_push(pngle_t *pngle, uint8_t value)
-{
-  pngle->scanline_ringbuf[pngle->scanline_ringbuf_cidx] = value;
-  pngle->scanline_ringbuf_cidx = (pngle->scanline_ringbuf_cidx + 1) % pngle->scanline_ringbuf_size;
-}
-
-static inline uint16_t get_value(pngle_t *pngle, size_t *ridx, int *bitcount, int depth)
+static inline uint16_t get_value(const uint8_t **p, int *bitcount, int depth)
 {
   uint16_t v;
 
@@ -253,42 +448,213 @@ static inline uint16_t get_value(pngle_t *pngle, size_t *ridx, int *bitcount, in
   case 4:
     if (*bitcount >= 8) {
       *bitcount = 0;
-      *ridx = (*ridx + 1) % pngle->scanline_ringbuf_size;
+      (*p)++;
     }
     *bitcount += depth;
     uint8_t mask = ((1UL << depth) - 1);
     uint8_t shift = (8 - *bitcount);
-    return (pngle->scanline_ringbuf[*ridx] >> shift) & mask;
+    return (**p >> shift) & mask;
 
   case 8:
-    v = pngle->scanline_ringbuf[*ridx];
-    *ridx = (*ridx + 1) % pngle->scanline_ringbuf_size;
-    return v;
+    return *(*p)++;
 
   case 16:
-    v = pngle->scanline_ringbuf[*ridx];
-    *ridx = (*ridx + 1) % pngle->scanline_ringbuf_size;
-
-    v = v * 0x100 + pngle->scanline_ringbuf[*ridx];
-    *ridx = (*ridx + 1) % pngle->scanline_ringbuf_size;
+    v = *(*p)++;
+    v = v * 0x100 + *(*p)++;
     return v;
   }
 
   return 0;
 }
 
-static int pngle_draw_pixels(pngle_t *pngle, size_t scanline_ringbuf_xidx)
+
+// ---------------------------------------------------------------------------
+// Row decode kernels
+//
+// Each kernel converts one unfiltered scanline of n pixels into the row
+// buffer, either as rgba8888 or as RGB565BE plus row_mask. They are picked
+// once per image by select_kernels(), so the loops below carry no per-pixel
+// color type / bit depth dispatch. Packed (1/2/4 bit) formats and gamma
+// corrected images use the generic kernel and its bit reader.
+// ---------------------------------------------------------------------------
+
+// 16 bit sample to 8 bit, identical to (v * 255 + 32767) / 65535
+#define U16_TO_U8(v) ((uint8_t)(((uint32_t)(v) * 255 + 32895) >> 16))
+
+// x / 255 rounded, exact for 0 <= x <= 65535
+#define DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+
+// Composite over the background: c * a / 255 + bg * (255 - a) / 255, the latter from the LUT
+static inline uint8_t blend(const uint16_t *lut, uint8_t c, uint8_t a)
+{
+  uint32_t v = c * a + lut[a];
+  return DIV255(v);
+}
+
+PNGLE_INLINE void put_pixel(pngle_t *pngle, uint8_t *dst, uint32_t i, uint8_t r, uint8_t g, uint8_t b, uint8_t a, int rgb565)
+{
+  if (a != 255 && pngle->blend_lut) {
+    r = blend(pngle->blend_lut + 0 * 256, r, a);
+    g = blend(pngle->blend_lut + 1 * 256, g, a);
+    b = blend(pngle->blend_lut + 2 * 256, b, a);
+    a = 255;
+  }
+
+  if (rgb565) {
+    uint16_t color = (r << 8 & 0xf800) | (g << 3 & 0x07e0) | (b >> 3 & 0x001f);
+    dst[i * 2 + 0] = color >> 8;
+    dst[i * 2 + 1] = color & 0xff;
+
+    uint8_t bit = 0x80 >> (i & 7);
+    if (a > 127) pngle->row_mask[i >> 3] |= bit;
+    else         pngle->row_mask[i >> 3] &= ~bit;
+  } else {
+    dst[i * 4 + 0] = r;
+    dst[i * 4 + 1] = g;
+    dst[i * 4 + 2] = b;
+    dst[i * 4 + 3] = a;
+  }
+}
+
+PNGLE_INLINE int decode_gray8(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  int32_t tk = pngle->trans_key[0];
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t v = src[i];
+    put_pixel(pngle, dst, i, v, v, v, v == tk ? 0 : 255, rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_gray16(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  int32_t tk = pngle->trans_key[0];
+  for (uint32_t i = 0; i < n; i++, src += 2) {
+    uint16_t v = src[0] << 8 | src[1];
+    uint8_t y = U16_TO_U8(v);
+    put_pixel(pngle, dst, i, y, y, y, v == tk ? 0 : 255, rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_rgb8(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  int32_t tr = pngle->trans_key[0], tg = pngle->trans_key[1], tb = pngle->trans_key[2];
+  for (uint32_t i = 0; i < n; i++, src += 3) {
+    put_pixel(pngle, dst, i, src[0], src[1], src[2], (src[0] == tr && src[1] == tg && src[2] == tb) ? 0 : 255, rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_rgb16(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  int32_t tr = pngle->trans_key[0], tg = pngle->trans_key[1], tb = pngle->trans_key[2];
+  for (uint32_t i = 0; i < n; i++, src += 6) {
+    uint16_t r = src[0] << 8 | src[1];
+    uint16_t g = src[2] << 8 | src[3];
+    uint16_t b = src[4] << 8 | src[5];
+    put_pixel(pngle, dst, i, U16_TO_U8(r), U16_TO_U8(g), U16_TO_U8(b), (r == tr && g == tg && b == tb) ? 0 : 255, rgb565);
+  }
+  return 0;
+}
+
+// Indexed color through the palette lookup tables built by setup_palette_lut(): one table load per pixel
+PNGLE_INLINE int decode_indexed(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565, int depth)
+{
+  const uint8_t mask = (1 << depth) - 1;
+  const int pixels_per_byte = 8 / depth;
+  const int check_range = pngle->n_palettes < (1UL << depth);
+  uint8_t m = 0;
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t pidx = depth == 8 ? src[i] : (src[i / pixels_per_byte] >> (8 - depth * (i % pixels_per_byte + 1))) & mask;
+    if (check_range && pidx >= pngle->n_palettes) return PNGLE_ERROR("Color index is out of range");
+
+    if (rgb565) {
+      ((uint16_t *)dst)[i] = pngle->lut_rgb565be[pidx];
+      m = (m << 1) | pngle->lut_opaque[pidx];
+      if ((i & 7) == 7) pngle->row_mask[i >> 3] = m;
+    } else {
+      memcpy(dst + i * 4, pngle->lut_rgba8888 + pidx * 4, 4);
+    }
+  }
+  if (rgb565 && (n & 7)) pngle->row_mask[n >> 3] = m << (8 - (n & 7));
+
+  return 0;
+}
+
+PNGLE_INLINE int decode_indexed1(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565) { return decode_indexed(pngle, src, n, dst, rgb565, 1); }
+PNGLE_INLINE int decode_indexed2(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565) { return decode_indexed(pngle, src, n, dst, rgb565, 2); }
+PNGLE_INLINE int decode_indexed4(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565) { return decode_indexed(pngle, src, n, dst, rgb565, 4); }
+PNGLE_INLINE int decode_indexed8(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565) { return decode_indexed(pngle, src, n, dst, rgb565, 8); }
+
+PNGLE_INLINE int decode_gray_alpha8(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  for (uint32_t i = 0; i < n; i++, src += 2) {
+    put_pixel(pngle, dst, i, src[0], src[0], src[0], src[1], rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_gray_alpha16(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  for (uint32_t i = 0; i < n; i++, src += 4) {
+    uint8_t y = U16_TO_U8(src[0] << 8 | src[1]);
+    put_pixel(pngle, dst, i, y, y, y, U16_TO_U8(src[2] << 8 | src[3]), rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_rgba8(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  if (!rgb565 && !pngle->blend_lut) {
+    memcpy(dst, src, n * 4);
+    return 0;
+  }
+  for (uint32_t i = 0; i < n; i++, src += 4) {
+    put_pixel(pngle, dst, i, src[0], src[1], src[2], src[3], rgb565);
+  }
+  return 0;
+}
+
+PNGLE_INLINE int decode_rgba16(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
+{
+  for (uint32_t i = 0; i < n; i++, src += 8) {
+    put_pixel(pngle, dst, i
+      , U16_TO_U8(src[0] << 8 | src[1])
+      , U16_TO_U8(src[2] << 8 | src[3])
+      , U16_TO_U8(src[4] << 8 | src[5])
+      , U16_TO_U8(src[6] << 8 | src[7])
+      , rgb565
+    );
+  }
+  return 0;
+}
+
+#ifndef PNGLE_NO_GAMMA_CORRECTION
+// Largest output level whose step is <= v (see setup_gamma_table())
+static inline uint8_t gamma16(const uint16_t *steps, uint16_t v)
+{
+  uint_fast16_t o = 0;
+  for (uint_fast16_t bit = 128; bit; bit >>= 1) {
+    if (steps[o + bit] <= v) o += bit;
+  }
+  return o;
+}
+#endif
+
+// Any color type and bit depth, with tRNS and gamma correction
+PNGLE_INLINE int decode_generic(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst, int rgb565)
 {
   uint16_t v[4]; // MAX_CHANNELS
   int bitcount = 0;
   uint8_t pixel_depth = (pngle->hdr.color_type & 1) ? 8 : pngle->hdr.depth;
   uint16_t maxval = (1UL << pixel_depth) - 1;
+  uint16_t scale8 = pixel_depth == 16 ? 0 : 255 / maxval; // exact for 1, 2, 4 and 8 bits; 0 means 16 bit
 
-  int n_pixels = pngle->hdr.depth == 16 ? 1 : (8 / pngle->hdr.depth);
-
-  for (; n_pixels-- > 0 && pngle->drawing_x < pngle->hdr.width; pngle->drawing_x = U32_CLAMP_ADD(pngle->drawing_x, interlace_div_x[pngle->interlace_pass], pngle->hdr.width)) {
+  for (uint32_t i = 0; i < n; i++) {
     for (uint_fast8_t c = 0; c < pngle->channels; c++) {
-      v[c] = get_value(pngle, &scanline_ringbuf_xidx, &bitcount, pngle->hdr.depth);
+      v[c] = get_value(&src, &bitcount, pngle->hdr.depth);
     }
 
     // color type: 0000 0111
@@ -323,28 +689,329 @@ static int pngle_draw_pixels(pngle_t *pngle, size_t scanline_ringbuf_xidx)
       v[1] = v[2] = v[0];
     }
 
-    if (pngle->draw_callback) {
-      uint8_t rgba[4] = {
-        (v[0] * 255 + maxval / 2) / maxval,
-        (v[1] * 255 + maxval / 2) / maxval,
-        (v[2] * 255 + maxval / 2) / maxval,
-        (v[3] * 255 + maxval / 2) / maxval
-      };
+    uint8_t rgba[4];
+    for (int c = 0; c < 4; c++) {
+      rgba[c] = scale8 ? v[c] * scale8 : U16_TO_U8(v[c]);
+    }
 
 #ifndef PNGLE_NO_GAMMA_CORRECTION
-      if (pngle->gamma_table) {
-        for (int i = 0; i < 3; i++) {
-          rgba[i] = pngle->gamma_table[v[i]];
-        }
+    if (pngle->gamma_steps) {
+      for (int c = 0; c < 3; c++) {
+        rgba[c] = gamma16(pngle->gamma_steps, v[c]);
       }
+    } else if (pngle->gamma_table) {
+      for (int c = 0; c < 3; c++) {
+        rgba[c] = pngle->gamma_table[rgba[c]];
+      }
+    }
+#endif
+
+    put_pixel(pngle, dst, i, rgba[0], rgba[1], rgba[2], rgba[3], rgb565);
+  }
+
+  return 0;
+}
+
+#define PNGLE_KERNEL_PAIR(name) \
+  static int name##_rgba8888(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst) { return name(pngle, src, n, dst, 0); } \
+  static int name##_rgb565be(pngle_t *pngle, const uint8_t *src, uint32_t n, uint8_t *dst) { return name(pngle, src, n, dst, 1); }
+
+PNGLE_KERNEL_PAIR(decode_gray8)
+PNGLE_KERNEL_PAIR(decode_gray16)
+PNGLE_KERNEL_PAIR(decode_rgb8)
+PNGLE_KERNEL_PAIR(decode_rgb16)
+PNGLE_KERNEL_PAIR(decode_indexed1)
+PNGLE_KERNEL_PAIR(decode_indexed2)
+PNGLE_KERNEL_PAIR(decode_indexed4)
+PNGLE_KERNEL_PAIR(decode_indexed8)
+PNGLE_KERNEL_PAIR(decode_gray_alpha8)
+PNGLE_KERNEL_PAIR(decode_gray_alpha16)
+PNGLE_KERNEL_PAIR(decode_rgba8)
+PNGLE_KERNEL_PAIR(decode_rgba16)
+PNGLE_KERNEL_PAIR(decode_generic)
+
+static const struct {
+  uint8_t color_type;
+  uint8_t depth;
+  pngle_kernel_t rgba8888;
+  pngle_kernel_t rgb565be;
+} pngle_kernels[] = {
+  { 0,  8, decode_gray8_rgba8888,        decode_gray8_rgb565be        },
+  { 0, 16, decode_gray16_rgba8888,       decode_gray16_rgb565be       },
+  { 2,  8, decode_rgb8_rgba8888,         decode_rgb8_rgb565be         },
+  { 2, 16, decode_rgb16_rgba8888,        decode_rgb16_rgb565be        },
+  { 3,  1, decode_indexed1_rgba8888,     decode_indexed1_rgb565be     },
+  { 3,  2, decode_indexed2_rgba8888,     decode_indexed2_rgb565be     },
+  { 3,  4, decode_indexed4_rgba8888,     decode_indexed4_rgb565be     },
+  { 3,  8, decode_indexed8_rgba8888,     decode_indexed8_rgb565be     },
+  { 4,  8, decode_gray_alpha8_rgba8888,  decode_gray_alpha8_rgb565be  },
+  { 4, 16, decode_gray_alpha16_rgba8888, decode_gray_alpha16_rgb565be },
+  { 6,  8, decode_rgba8_rgba8888,        decode_rgba8_rgb565be        },
+  { 6, 16, decode_rgba16_rgba8888,       decode_rgba16_rgb565be       },
+};
+
+// Final output pixel for every palette index: PLTE color, tRNS alpha and gamma folded in once per image
+static int setup_palette_lut(pngle_t *pngle)
+{
+  if ((pngle->lut_rgba8888 = PNGLE_ALLOC(256, 4, "palette lut rgba8888")) == NULL) return PNGLE_ERROR("Insufficient memory");
+  if ((pngle->lut_rgb565be = PNGLE_ALLOC(256, 2, "palette lut rgb565be")) == NULL) return PNGLE_ERROR("Insufficient memory");
+  if ((pngle->lut_opaque   = PNGLE_ALLOC(256, 1, "palette lut opaque"  )) == NULL) return PNGLE_ERROR("Insufficient memory");
+
+  for (size_t i = 0; i < pngle->n_palettes; i++) {
+    uint8_t *rgba = pngle->lut_rgba8888 + i * 4;
+    for (int c = 0; c < 3; c++) {
+      rgba[c] = pngle->palette[i * 3 + c];
+#ifndef PNGLE_NO_GAMMA_CORRECTION
+      if (pngle->gamma_table) rgba[c] = pngle->gamma_table[rgba[c]];
+#endif
+    }
+    rgba[3] = i < pngle->n_trans_palettes ? pngle->trans_palette[i] : 255;
+
+    if (pngle->blend_lut && rgba[3] != 255) {
+      for (int c = 0; c < 3; c++) rgba[c] = blend(pngle->blend_lut + c * 256, rgba[c], rgba[3]);
+      rgba[3] = 255;
+    }
+
+    uint16_t color = (rgba[0] << 8 & 0xf800) | (rgba[1] << 3 & 0x07e0) | (rgba[2] >> 3 & 0x001f);
+    uint8_t *be = (uint8_t *)&pngle->lut_rgb565be[i];
+    be[0] = color >> 8;
+    be[1] = color & 0xff;
+
+    pngle->lut_opaque[i] = rgba[3] > 127;
+  }
+
+  return 0;
+}
+
+// Called on the first IDAT, once PLTE / tRNS / gAMA are known
+static int select_kernels(pngle_t *pngle)
+{
+  // tRNS color key for color type 0 and 2; -1 never matches a sample
+  for (int c = 0; c < 3; c++) {
+    pngle->trans_key[c] = -1;
+    if (pngle->n_trans_palettes == 1 && !(pngle->hdr.color_type & 1) && (c == 0 || pngle->hdr.color_type == 2)) {
+      pngle->trans_key[c] = pngle->trans_palette[c * 2 + 0] * 0x100 + pngle->trans_palette[c * 2 + 1];
+    }
+  }
+
+  if (pngle->blend_enabled) {
+    if ((pngle->blend_lut = PNGLE_ALLOC(3 * 256, sizeof(uint16_t), "blend lut")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    for (int c = 0; c < 3; c++) {
+      for (int a = 0; a < 256; a++) pngle->blend_lut[c * 256 + a] = pngle->blend_bg[c] * (255 - a);
+    }
+  }
+
+  pngle->kernel_rgba8888 = decode_generic_rgba8888;
+  pngle->kernel_rgb565be = decode_generic_rgb565be;
+
+  if (pngle->hdr.color_type == 3) {
+    // gamma is already applied to the lookup tables
+    if (setup_palette_lut(pngle) < 0) return -1;
+  } else {
+#ifndef PNGLE_NO_GAMMA_CORRECTION
+    if (pngle->gamma_table || pngle->gamma_steps) return 0;
 #endif
+  }
+
+  for (size_t i = 0; i < sizeof(pngle_kernels) / sizeof(pngle_kernels[0]); i++) {
+    if (pngle_kernels[i].color_type == pngle->hdr.color_type && pngle_kernels[i].depth == pngle->hdr.depth) {
+      pngle->kernel_rgba8888 = pngle_kernels[i].rgba8888;
+      pngle->kernel_rgb565be = pngle_kernels[i].rgb565be;
+      break;
+    }
+  }
+
+  return 0;
+}
+
+// Output size for the current scale
+static inline uint32_t scaled(pngle_t *pngle, uint32_t v)
+{
+  return (v >> pngle->scale_shift) + ((v & ((1UL << pngle->scale_shift) - 1)) ? 1 : 0);
+}
+
+// Bottom edge of what still has to be drawn, in image rows: the clip rectangle or the image
+static inline uint32_t clip_bottom(pngle_t *pngle)
+{
+  if (!pngle->clip_enabled || pngle->clip_y1 > (pngle->hdr.height >> pngle->scale_shift)) return pngle->hdr.height;
+  return pngle->clip_y1 << pngle->scale_shift;
+}
 
-      pngle->draw_callback(pngle, pngle->drawing_x, pngle->drawing_y
-        , MIN(interlace_div_x[pngle->interlace_pass] - interlace_off_x[pngle->interlace_pass], pngle->hdr.width  - pngle->drawing_x)
-        , MIN(interlace_div_y[pngle->interlace_pass] - interlace_off_y[pngle->interlace_pass], pngle->hdr.height - pngle->drawing_y)
-        , rgba
-      );
+// Last interlace pass that still draws something; Adam7 passes with odd offsets have no pixel on the downscaled grid
+static uint_fast8_t last_pass(pngle_t *pngle)
+{
+  if (!pngle->hdr.interlace) return 0;
+
+  uint32_t mask = (1UL << pngle->scale_shift) - 1;
+  uint_fast8_t pass = 7;
+  while (pass > 1 && ((interlace_off_x[pass] | interlace_off_y[pass]) & mask)) pass--;
+  return pass;
+}
+
+// Hand output to the user callbacks
+static inline void emit_row(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const void *pixels)
+{
+  PNGLE_STATS_BEGIN(t0);
+  pngle->row_callback(pngle, x, y, n, pixels);
+  PNGLE_STATS_END(t0, cycles_draw);
+  PNGLE_STATS_ADD(pixels_emitted, n);
+  PNGLE_STATS_ADD(callbacks, 1);
+}
+
+static inline void emit_pixel(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t *rgba)
+{
+  PNGLE_STATS_BEGIN(t0);
+  pngle->draw_callback(pngle, x, y, w, h, rgba);
+  PNGLE_STATS_END(t0, cycles_draw);
+  PNGLE_STATS_ADD(pixels_emitted, 1);
+  PNGLE_STATS_ADD(callbacks, 1);
+}
+
+// Downscaled rows: box average for non-interlaced images, point sampling for interlaced ones
+static int pngle_draw_row_scaled(pngle_t *pngle)
+{
+  uint32_t shift = pngle->scale_shift;
+  uint32_t f = 1UL << shift;
+  uint32_t cx0 = 0, cx1 = scaled(pngle, pngle->hdr.width);
+  uint32_t cy0 = 0, cy1 = scaled(pngle, pngle->hdr.height);
+  if (pngle->clip_enabled) {
+    cx0 = pngle->clip_x0;
+    cy0 = pngle->clip_y0;
+    cx1 = MIN(pngle->clip_x1, cx1);
+    cy1 = MIN(pngle->clip_y1, cy1);
+  }
+  if (cx0 >= cx1 || cy0 >= cy1) return 0;
+
+  uint32_t y = pngle->drawing_y;
+
+  if (pngle->interlace_pass > 0) {
+    if (!pngle->draw_callback || (y & (f - 1))) return 0;
+
+    uint32_t off_x = interlace_off_x[pngle->interlace_pass];
+    uint32_t div_x = interlace_div_x[pngle->interlace_pass];
+    uint32_t oy = y >> shift;
+    uint32_t oh = scaled(pngle, MIN(interlace_div_y[pngle->interlace_pass] - interlace_off_y[pngle->interlace_pass], pngle->hdr.height - y));
+    if (oy < cy0 || oy >= cy1) return 0;
+
+    if (pngle->kernel_rgba8888(pngle, pngle->scanline_cur, pngle->scanline_pixels, pngle->row_buf) < 0) return -1;
+
+    uint32_t x = off_x;
+    for (uint32_t i = 0; i < pngle->scanline_pixels; i++, x += div_x) {
+      if (x & (f - 1)) continue;
+
+      uint32_t ox = x >> shift;
+      uint32_t ow = scaled(pngle, MIN(div_x - off_x, pngle->hdr.width - x));
+      if (ox < cx0 || ox >= cx1) continue;
+
+      emit_pixel(pngle, ox, oy, MIN(ow, cx1 - ox), MIN(oh, cy1 - oy), pngle->row_buf + i * 4);
     }
+    return 0;
+  }
+
+  uint32_t oy = y >> shift;
+  if (oy < cy0 || oy >= cy1) return 0;
+
+  // Source pixels i0 .. i1-1 feed output pixels cx0 .. cx1-1
+  uint32_t i0 = cx0 << shift;
+  uint32_t i1 = MIN(cx1 << shift, pngle->hdr.width);
+  uint32_t bits = pngle->channels * pngle->hdr.depth;
+  uint32_t start = bits < 8 ? i0 - i0 % (8 / bits) : i0;
+
+  if (pngle->kernel_rgba8888(pngle, pngle->scanline_cur + start * bits / 8, i1 - start, pngle->row_buf) < 0) return -1;
+
+  // Colors are weighted by alpha so that transparent pixels don't bleed into the average
+  uint32_t *acc = pngle->scale_acc;
+  const uint8_t *px = pngle->row_buf + (i0 - start) * 4;
+  for (uint32_t i = i0; i < i1; i++, px += 4) {
+    uint32_t *a = acc + ((i >> shift) - cx0) * 4;
+    a[0] += px[0] * px[3];
+    a[1] += px[1] * px[3];
+    a[2] += px[2] * px[3];
+    a[3] += px[3];
+  }
+
+  if ((y & (f - 1)) != f - 1 && y + 1 < pngle->hdr.height) return 0; // block row not complete yet
+
+  int rgb565 = pngle->row_callback && pngle->output_format == PNGLE_OUTPUT_RGB565BE;
+  uint32_t n = cx1 - cx0;
+  uint32_t bh = (y & (f - 1)) + 1;
+  for (uint32_t o = 0; o < n; o++) {
+    uint32_t *a = acc + o * 4;
+    uint32_t count = MIN(f, pngle->hdr.width - ((cx0 + o) << shift)) * bh;
+    uint32_t sa = a[3];
+    uint8_t r = sa ? (a[0] + sa / 2) / sa : 0;
+    uint8_t g = sa ? (a[1] + sa / 2) / sa : 0;
+    uint8_t b = sa ? (a[2] + sa / 2) / sa : 0;
+    put_pixel(pngle, pngle->row_buf, o, r, g, b, (sa + count / 2) / count, rgb565);
+  }
+  memset(acc, 0, n * 4 * sizeof(uint32_t));
+
+  if (pngle->row_callback) {
+    emit_row(pngle, cx0, oy, n, pngle->row_buf);
+  } else if (pngle->draw_callback) {
+    for (uint32_t o = 0; o < n; o++) emit_pixel(pngle, cx0 + o, oy, 1, 1, pngle->row_buf + o * 4);
+  }
+
+  return 0;
+}
+
+static int pngle_draw_row(pngle_t *pngle)
+{
+  if (pngle->scale_shift) return pngle_draw_row_scaled(pngle);
+
+  // Whole scanlines are only available on passes without horizontal gaps (non-interlaced, or Adam7 pass 7)
+  int row_mode = pngle->row_callback && interlace_div_x[pngle->interlace_pass] == 1;
+  if (!row_mode && !pngle->draw_callback) return 0;
+
+  uint32_t off_x = interlace_off_x[pngle->interlace_pass];
+  uint32_t div_x = interlace_div_x[pngle->interlace_pass];
+  uint32_t cx0 = 0, cx1 = pngle->hdr.width;
+  uint32_t cy0 = 0, cy1 = clip_bottom(pngle);
+  if (pngle->clip_enabled) {
+    cx0 = pngle->clip_x0;
+    cy0 = pngle->clip_y0;
+    cx1 = MIN(pngle->clip_x1, pngle->hdr.width);
+  }
+
+  // Rows and pixels outside the clip rectangle are not decoded at all. Blocks of earlier interlace
+  // passes are cut at its right / bottom edge, but dropped if their own pixel is outside: the draw
+  // callback may well paint nothing but (x, y)
+  uint32_t y = pngle->drawing_y;
+  uint32_t h = MIN(interlace_div_y[pngle->interlace_pass] - interlace_off_y[pngle->interlace_pass], pngle->hdr.height - y);
+  if (cx0 >= cx1 || y < cy0 || y >= cy1) return 0;
+
+  // Pixels i0 .. i1-1 of this pass are inside the clip rectangle
+  uint32_t i0 = cx0 > off_x ? (cx0 - off_x + div_x - 1) / div_x : 0;
+  uint32_t i1 = cx1 > off_x ? MIN((cx1 - off_x + div_x - 1) / div_x, pngle->scanline_pixels) : 0;
+  if (i0 >= i1) return 0;
+
+  // Kernels start on a byte boundary; sub-byte depths decode up to 7 extra pixels on the left
+  uint32_t bits = pngle->channels * pngle->hdr.depth;
+  uint32_t start = bits < 8 ? i0 - i0 % (8 / bits) : i0;
+  uint32_t skip = i0 - start;
+
+  int rgb565 = row_mode && pngle->output_format == PNGLE_OUTPUT_RGB565BE;
+  pngle_kernel_t kernel = rgb565 ? pngle->kernel_rgb565be : pngle->kernel_rgba8888;
+
+  if (kernel(pngle, pngle->scanline_cur + start * bits / 8, i1 - start, pngle->row_buf) < 0) return -1;
+
+  if (row_mode) {
+    if (skip && rgb565) {
+      // realign the mask so that its first bit is pixel i0
+      uint8_t *m = pngle->row_mask;
+      size_t bytes = (i1 - start + 7) / 8;
+      for (size_t k = 0; k < bytes; k++) {
+        m[k] = (m[k] << skip) | (k + 1 < bytes ? m[k + 1] >> (8 - skip) : 0);
+      }
+    }
+    emit_row(pngle, i0, y, i1 - i0, pngle->row_buf + skip * (rgb565 ? 2 : 4));
+    return 0;
+  }
+
+  uint32_t x = off_x + i0 * div_x;
+  for (uint32_t i = i0; i < i1; i++, x += div_x) {
+    uint32_t w = MIN(div_x - off_x, pngle->hdr.width - x);
+    emit_pixel(pngle, x, y, MIN(w, cx1 - x), MIN(h, cy1 - y), pngle->row_buf + (i - start) * 4);
   }
 
   return 0;
@@ -362,47 +1029,205 @@ static inline int paeth(int a, int b, int c)
   return c;
 }
 
+// ---------------------------------------------------------------------------
+// Filter reversal, one whole scanline at a time
+//
+// cur holds the filtered bytes of the row and is reconstructed in place,
+// prev is the previous reconstructed row (zeros on the first row of a pass).
+// The loops are kept free of calls and indexing tricks so the compiler can
+// vectorize Up and unroll the others; bpp is a constant in the common cases.
+// ---------------------------------------------------------------------------
+
+PNGLE_INLINE void unfilter_sub(uint8_t *cur, size_t n, size_t bpp)
+{
+  for (size_t i = bpp; i < n; i++) cur[i] += cur[i - bpp];
+}
+
+PNGLE_INLINE void unfilter_up(uint8_t *cur, const uint8_t *prev, size_t n)
+{
+  for (size_t i = 0; i < n; i++) cur[i] += prev[i];
+}
+
+PNGLE_INLINE void unfilter_average(uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp)
+{
+  size_t i = 0;
+  for (; i < bpp && i < n; i++) cur[i] += prev[i] >> 1;
+  for (; i < n; i++) cur[i] += (cur[i - bpp] + prev[i]) >> 1;
+}
+
+PNGLE_INLINE void unfilter_paeth(uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp)
+{
+  size_t i = 0;
+  for (; i < bpp && i < n; i++) cur[i] += prev[i]; // paeth(0, b, 0) == b
+  for (; i < n; i++) cur[i] += paeth(cur[i - bpp], prev[i], prev[i - bpp]);
+}
+
+PNGLE_INLINE void unfilter_row_bpp(int filter_type, uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp)
+{
+  switch (filter_type) {
+  case 0: break; // None
+  case 1: unfilter_sub(cur, n, bpp); break;
+  case 2: unfilter_up(cur, prev, n); break;
+  case 3: unfilter_average(cur, prev, n, bpp); break;
+  case 4: unfilter_paeth(cur, prev, n, bpp); break;
+  }
+}
+
+static void unfilter_row(pngle_t *pngle)
+{
+  uint8_t *cur = pngle->scanline_cur;
+  const uint8_t *prev = pngle->scanline_prev;
+  size_t n = pngle->scanline_stride;
+
+  // constant bpp lets the compiler unroll the Sub/Average/Paeth dependency chains
+  switch ((pngle->channels * pngle->hdr.depth + 7) / 8) { // 1 if depth <= 8
+  case 1:  unfilter_row_bpp(pngle->filter_type, cur, prev, n, 1); break;
+  case 2:  unfilter_row_bpp(pngle->filter_type, cur, prev, n, 2); break;
+  case 3:  unfilter_row_bpp(pngle->filter_type, cur, prev, n, 3); break;
+  case 4:  unfilter_row_bpp(pngle->filter_type, cur, prev, n, 4); break;
+  default: unfilter_row_bpp(pngle->filter_type, cur, prev, n, (pngle->channels * pngle->hdr.depth + 7) / 8); break;
+  }
+}
+
 static int set_interlace_pass(pngle_t *pngle, uint_fast8_t pass)
 {
   pngle->interlace_pass = pass;
 
-  uint_fast8_t bytes_per_pixel = (pngle->channels * pngle->hdr.depth + 7) / 8; // 1 if depth <= 8
   size_t scanline_pixels = (pngle->hdr.width - interlace_off_x[pngle->interlace_pass] + interlace_div_x[pngle->interlace_pass] - 1) / interlace_div_x[pngle->interlace_pass];
   size_t scanline_stride = (scanline_pixels * pngle->channels * pngle->hdr.depth + 7) / 8;
 
-  pngle->scanline_ringbuf_size = scanline_stride + bytes_per_pixel * 2; // 2 rooms for c/x and a
+  pngle->scanline_pixels = scanline_pixels;
+  pngle->scanline_stride = scanline_stride;
+  pngle->scanline_idx = 0;
 
-  if (pngle->scanline_ringbuf) free(pngle->scanline_ringbuf);
-  if ((pngle->scanline_ringbuf = PNGLE_CALLOC(pngle->scanline_ringbuf_size, 1, "scanline ringbuf")) == NULL) return PNGLE_ERROR("Insufficient memory");
+  // "Up" filters of the first row of each pass refer to an all-zero row
+  memset(pngle->scanline_prev, 0, scanline_stride);
 
-  pngle->drawing_x = interlace_off_x[pngle->interlace_pass];
   pngle->drawing_y = interlace_off_y[pngle->interlace_pass];
   pngle->filter_type = -1;
 
-  pngle->scanline_ringbuf_cidx = 0;
-  pngle->scanline_remain_bytes_to_render = -1;
-
   return 0;
 }
 
+#ifndef PNGLE_NO_GAMMA_CORRECTION
+// Common (gAMA, display gamma) pairs, generated by tools/gamma_tables.py so they need no pow() at decode time
+static const uint8_t gamma_100000_2_2[256] = {
+    0,  21,  28,  34,  39,  43,  46,  50,  53,  56,  59,  61,  64,  66,  68,  70,
+   72,  74,  76,  78,  80,  82,  84,  85,  87,  89,  90,  92,  93,  95,  96,  98,
+   99, 101, 102, 103, 105, 106, 107, 109, 110, 111, 112, 114, 115, 116, 117, 118,
+  119, 120, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135,
+  136, 137, 138, 139, 140, 141, 142, 143, 144, 144, 145, 146, 147, 148, 149, 150,
+  151, 151, 152, 153, 154, 155, 156, 156, 157, 158, 159, 160, 160, 161, 162, 163,
+  164, 164, 165, 166, 167, 167, 168, 169, 170, 170, 171, 172, 173, 173, 174, 175,
+  175, 176, 177, 178, 178, 179, 180, 180, 181, 182, 182, 183, 184, 184, 185, 186,
+  186, 187, 188, 188, 189, 190, 190, 191, 192, 192, 193, 194, 194, 195, 195, 196,
+  197, 197, 198, 199, 199, 200, 200, 201, 202, 202, 203, 203, 204, 205, 205, 206,
+  206, 207, 207, 208, 209, 209, 210, 210, 211, 212, 212, 213, 213, 214, 214, 215,
+  215, 216, 217, 217, 218, 218, 219, 219, 220, 220, 221, 221, 222, 223, 223, 224,
+  224, 225, 225, 226, 226, 227, 227, 228, 228, 229, 229, 230, 230, 231, 231, 232,
+  232, 233, 233, 234, 234, 235, 235, 236, 236, 237, 237, 238, 238, 239, 239, 240,
+  240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 247, 247, 248,
+  248, 249, 249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255, 255,
+};
+
+static const uint8_t gamma_55556_2_2[256] = {
+    0,   3,   5,   7,   9,  10,  12,  13,  15,  17,  18,  19,  21,  22,  24,  25,
+   26,  28,  29,  30,  32,  33,  34,  36,  37,  38,  39,  41,  42,  43,  44,  45,
+   47,  48,  49,  50,  51,  53,  54,  55,  56,  57,  58,  59,  61,  62,  63,  64,
+   65,  66,  67,  68,  69,  71,  72,  73,  74,  75,  76,  77,  78,  79,  80,  81,
+   82,  83,  84,  85,  86,  88,  89,  90,  91,  92,  93,  94,  95,  96,  97,  98,
+   99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114,
+  115, 116, 117, 118, 119, 120, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129,
+  130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 140, 141, 142, 143, 144,
+  145, 146, 147, 148, 149, 150, 151, 152, 152, 153, 154, 155, 156, 157, 158, 159,
+  160, 161, 162, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 171, 172, 173,
+  174, 175, 176, 177, 178, 179, 179, 180, 181, 182, 183, 184, 185, 186, 187, 187,
+  188, 189, 190, 191, 192, 193, 194, 194, 195, 196, 197, 198, 199, 200, 200, 201,
+  202, 203, 204, 205, 206, 206, 207, 208, 209, 210, 211, 212, 212, 213, 214, 215,
+  216, 217, 218, 218, 219, 220, 221, 222, 223, 223, 224, 225, 226, 227, 228, 229,
+  229, 230, 231, 232, 233, 234, 234, 235, 236, 237, 238, 239, 239, 240, 241, 242,
+  243, 243, 244, 245, 246, 247, 248, 248, 249, 250, 251, 252, 253, 253, 254, 255,
+};
+
+static const uint8_t gamma_45455_1[256] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+static const struct {
+  uint32_t png_gamma;
+  double display_gamma;
+  const uint8_t *table;
+} gamma_presets[] = {
+  { 100000, 2.2, gamma_100000_2_2 },
+  {  55556, 2.2, gamma_55556_2_2  },
+  {  45455, 1.0, gamma_45455_1    },
+};
+
+static inline uint8_t gamma_level(uint32_t v, uint32_t maxval, double exponent)
+{
+  return (uint8_t)floor(pow(v / (double)maxval, exponent) * 255.0 + 0.5);
+}
+#endif
+
 static int setup_gamma_table(pngle_t *pngle, uint32_t png_gamma)
 {
 #ifndef PNGLE_NO_GAMMA_CORRECTION
-  if (pngle->gamma_table) free(pngle->gamma_table);
+  if (pngle->gamma_buf) PNGLE_FREE(pngle->gamma_buf);
+  if (pngle->gamma_steps) PNGLE_FREE(pngle->gamma_steps);
+  pngle->gamma_table = NULL;
+  pngle->gamma_steps = NULL;
+  pngle->gamma_buf = NULL;
 
   if (pngle->display_gamma <= 0) return 0; // disable gamma correction
   if (png_gamma == 0) return 0;
+  debug_printf("[pngle] gamma value = %d\n", png_gamma);
 
-  uint8_t pixel_depth = (pngle->hdr.color_type & 1) ? 8 : pngle->hdr.depth;
-  uint16_t maxval = (1UL << pixel_depth) - 1;
+  double exponent = 100000.0 / png_gamma / pngle->display_gamma;
 
-  pngle->gamma_table = PNGLE_CALLOC(1, maxval + 1, "gamma table");
-  if (!pngle->gamma_table) return PNGLE_ERROR("Insufficient memory");
+  // Close enough to 1 that every 8-bit level maps to itself (e.g. 1/2.2 image on a 2.2 display): keep the fast kernels
+  if (fabs(exponent - 1.0) < 0.001 && pngle->hdr.depth <= 8) return 0;
 
-  for (int i = 0; i < maxval + 1; i++) {
-    pngle->gamma_table[i] = (uint8_t)floor(pow(i / (double)maxval, 100000.0 / png_gamma / pngle->display_gamma) * 255.0 + 0.5);
+  if (pngle->hdr.depth == 16) {
+    // 256 thresholds instead of a 64K-entry table; a first guess from the inverse curve, then exact
+    if ((pngle->gamma_steps = PNGLE_ALLOC(256, sizeof(uint16_t), "gamma steps")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    for (uint32_t o = 1; o < 256; o++) {
+      uint32_t v = (uint32_t)ceil(65535.0 * pow((o - 0.5) / 255.0, 1.0 / exponent));
+      if (v > 65535) v = 65535;
+      while (v > 0 && gamma_level(v - 1, 65535, exponent) >= o) v--;
+      while (v < 65535 && gamma_level(v, 65535, exponent) < o) v++;
+      pngle->gamma_steps[o] = v;
+    }
+    return 0;
   }
-  debug_printf("[pngle] gamma value = %d\n", png_gamma);
+
+  for (size_t i = 0; i < sizeof(gamma_presets) / sizeof(gamma_presets[0]); i++) {
+    if (gamma_presets[i].png_gamma == png_gamma && gamma_presets[i].display_gamma == pngle->display_gamma) {
+      pngle->gamma_table = gamma_presets[i].table;
+      return 0;
+    }
+  }
+
+  // Samples of 1 - 8 bits are scaled to 8 bits before the lookup, so 256 entries cover every depth
+  if ((pngle->gamma_buf = PNGLE_ALLOC(256, 1, "gamma table")) == NULL) return PNGLE_ERROR("Insufficient memory");
+  for (uint32_t i = 0; i < 256; i++) {
+    pngle->gamma_buf[i] = gamma_level(i, 255, exponent);
+  }
+  pngle->gamma_table = pngle->gamma_buf;
 #else
   PNGLE_UNUSED(pngle);
   PNGLE_UNUSED(png_gamma);
@@ -415,17 +1240,8 @@ static int pngle_on_data(pngle_t *pngle, const uint8_t *p, int len)
 {
   const uint8_t *ep = p + len;
 
-  uint_fast8_t bytes_per_pixel = (pngle->channels * pngle->hdr.depth + 7) / 8; // 1 if depth <= 8
-
   while (p < ep) {
-    if (pngle->drawing_x >= pngle->hdr.width) {
-      // New row
-      pngle->drawing_x = interlace_off_x[pngle->interlace_pass];
-      pngle->drawing_y = U32_CLAMP_ADD(pngle->drawing_y, interlace_div_y[pngle->interlace_pass], pngle->hdr.height);
-      pngle->filter_type = -1; // Indicate new line
-    }
-
-    if (pngle->drawing_x >= pngle->hdr.width || pngle->drawing_y >= pngle->hdr.height) {
+    if (pngle->scanline_pixels == 0 || pngle->drawing_y >= pngle->hdr.height) {
       if (pngle->interlace_pass == 0 || pngle->interlace_pass >= 7) return len; // Do nothing further
 
       // Interlace: Next pass
@@ -435,6 +1251,15 @@ static int pngle_on_data(pngle_t *pngle, const uint8_t *p, int len)
       continue; // This is required because "No filter type bytes are present in an empty pass".
     }
 
+    uint_fast8_t last = last_pass(pngle);
+    if (pngle->interlace_pass > last || (pngle->interlace_pass == last && pngle->drawing_y >= clip_bottom(pngle))) {
+      // Nothing left to draw (below the clip rectangle, or passes that miss the downscaled grid), so skip the rest of the stream
+      debug_printf("[pngle] Clip rectangle completed at y = %u\n", pngle->drawing_y);
+      pngle->state = PNGLE_STATE_EOF;
+      if (pngle->done_callback) pngle->done_callback(pngle);
+      return len;
+    }
+
     if (pngle->filter_type < 0) {
       if (*p > 4) {
         debug_printf("[pngle] Invalid filter type is found; 0x%02x\n", *p);
@@ -442,45 +1267,32 @@ static int pngle_on_data(pngle_t *pngle, const uint8_t *p, int len)
       }
 
       pngle->filter_type = (int_fast8_t)*p++; // 0 - 4
-
-      // push sentinel bytes for new line
-      for (uint_fast8_t i = 0; i < bytes_per_pixel; i++) {
-        scanline_ringbuf_push(pngle, 0);
-      }
-
       continue;
     }
 
-    size_t cidx =  pngle->scanline_ringbuf_cidx;
-    size_t bidx = (pngle->scanline_ringbuf_cidx                                + bytes_per_pixel) % pngle->scanline_ringbuf_size;
-    size_t aidx = (pngle->scanline_ringbuf_cidx + pngle->scanline_ringbuf_size - bytes_per_pixel) % pngle->scanline_ringbuf_size;
-    // debug_printf("[pngle] cidx = %zd, bidx = %zd, aidx = %zd\n", cidx, bidx, aidx);
-
-    uint8_t c = pngle->scanline_ringbuf[cidx]; // left-up
-    uint8_t b = pngle->scanline_ringbuf[bidx]; // up
-    uint8_t a = pngle->scanline_ringbuf[aidx]; // left
-    uint8_t x = *p++; // target
-    // debug_printf("[pngle] c = 0x%02x, b = 0x%02x, a = 0x%02x, x = 0x%02x\n", c, b, a, x);
-
-    // Reverse the filter
-    switch (pngle->filter_type) {
-    case 0: break; // None
-    case 1: x += a; break; // Sub
-    case 2: x += b; break; // Up
-    case 3: x += (a + b) / 2; break; // Average
-    case 4: x += paeth(a, b, c); break; // Paeth
-    }
-
-    scanline_ringbuf_push(pngle, x); // updates scanline_ringbuf_cidx
-
-    if (pngle->scanline_remain_bytes_to_render < 0) pngle->scanline_remain_bytes_to_render = bytes_per_pixel;
-    if (--pngle->scanline_remain_bytes_to_render == 0) {
-      size_t xidx = (pngle->scanline_ringbuf_cidx + pngle->scanline_ringbuf_size - bytes_per_pixel) % pngle->scanline_ringbuf_size;
-
-      if (pngle_draw_pixels(pngle, xidx) < 0) return -1;
-
-      pngle->scanline_remain_bytes_to_render = -1; // reset
-    }
+    // Gather the filtered bytes of the row
+    size_t n = MIN((size_t)(ep - p), pngle->scanline_stride - pngle->scanline_idx);
+    memcpy(pngle->scanline_cur + pngle->scanline_idx, p, n);
+    pngle->scanline_idx += n;
+    p += n;
+
+    if (pngle->scanline_idx < pngle->scanline_stride) break; // need more data
+
+    // Row completed
+    PNGLE_STATS_BEGIN(t0);
+    unfilter_row(pngle);
+    PNGLE_STATS_END(t0, cycles_unfilter);
+    PNGLE_STATS_ADD(rows_unfiltered, 1);
+    if (pngle_draw_row(pngle) < 0) return -1;
+
+    // New row; the reconstructed one becomes the reference for the next
+    uint8_t *t = pngle->scanline_prev;
+    pngle->scanline_prev = pngle->scanline_cur;
+    pngle->scanline_cur = t;
+
+    pngle->scanline_idx = 0;
+    pngle->drawing_y = U32_CLAMP_ADD(pngle->drawing_y, interlace_div_y[pngle->interlace_pass], pngle->hdr.height);
+    pngle->filter_type = -1; // Indicate new line
   }
 
   return len;
@@ -551,11 +1363,27 @@ static int pngle_handle_chunk(pngle_t *pngle, const uint8_t *buf, size_t len)
     if (pngle->hdr.compression != 0) return PNGLE_ERROR("Unsupported compression type in IHDR");
     if (pngle->hdr.filter      != 0) return PNGLE_ERROR("Unsupported filter type in IHDR");
 
+    // scanline buffers, sized for the widest pass
+    size_t scanline_stride = ((size_t)pngle->hdr.width * pngle->channels * pngle->hdr.depth + 7) / 8;
+    if ((pngle->scanline_buf = PNGLE_ALLOC(scanline_stride, 2, "scanline buf")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    pngle->scanline_cur  = pngle->scanline_buf;
+    pngle->scanline_prev = pngle->scanline_buf + scanline_stride;
+
     // interlace
     if (set_interlace_pass(pngle, pngle->hdr.interlace ? 1 : 0) < 0) return -1;
 
+    // row output
+    if ((pngle->row_buf = PNGLE_ALLOC(pngle->hdr.width, 4, "row buf")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    if (pngle->row_callback && pngle->output_format == PNGLE_OUTPUT_RGB565BE) {
+      if ((pngle->row_mask = PNGLE_ALLOC((pngle->hdr.width + 7) / 8, 1, "row mask")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    }
+
+    if (pngle->scale_shift && !pngle->hdr.interlace) {
+      if ((pngle->scale_acc = PNGLE_ALLOC(scaled(pngle, pngle->hdr.width) * 4, sizeof(uint32_t), "scale accumulator")) == NULL) return PNGLE_ERROR("Insufficient memory");
+    }
+
     // callback
-    if (pngle->init_callback) pngle->init_callback(pngle, pngle->hdr.width, pngle->hdr.height);
+    if (pngle->init_callback) pngle->init_callback(pngle, scaled(pngle, pngle->hdr.width), scaled(pngle, pngle->hdr.height));
 
     break;
 
@@ -571,6 +1399,7 @@ static int pngle_handle_chunk(pngle_t *pngle, const uint8_t *buf, size_t len)
     //debug_printf("[pngle]     in_bytes %zd, out_bytes %zd, next_out %p\n", in_bytes, out_bytes, pngle->next_out);
 
     // XXX: tinfl_decompress always requires (next_out - lz_buf + avail_out) == TINFL_LZ_DICT_SIZE
+    PNGLE_STATS_BEGIN(t0);
     tinfl_status status = tinfl_decompress(&pngle->inflator, (const mz_uint8 *)buf, &in_bytes, pngle->lz_buf, (mz_uint8 *)pngle->next_out, &out_bytes, TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_PARSE_ZLIB_HEADER);
 
     //debug_printf("[pngle]       tinfl_decompress\n");
@@ -582,22 +1411,27 @@ static int pngle_handle_chunk(pngle_t *pngle, const uint8_t *buf, size_t len)
       return PNGLE_ERROR("Failed to decompress the IDAT stream");
     }
 
+    PNGLE_STATS_END(t0, cycles_inflate);
+    PNGLE_STATS_ADD(bytes_inflated, out_bytes);
+
     pngle->next_out   += out_bytes;
     pngle->avail_out  -= out_bytes;
 
     // debug_printf("[pngle]         => avail_out %zd, next_out %p\n", pngle->avail_out, pngle->next_out);
 
-    if (status == TINFL_STATUS_DONE || pngle->avail_out == 0) {
-      // Output buffer is full, or decompression is done, so write buffer to output file.
-      // XXX: This is the only chance to process the buffer.
-      uint8_t *read_ptr = pngle->lz_buf;
-      size_t n = TINFL_LZ_DICT_SIZE - (size_t)pngle->avail_out;
-
+    // Hand over whatever this call inflated, so the rows it completed are drawn now rather than once lz_buf is full:
+    // that keeps a progressive preview moving, lets a clip rectangle end the decode early and bounds the work of a
+    // single pngle_feed(). The bytes stay in lz_buf, where tinfl reads its back references, until it wraps.
+    if (pngle->next_out > pngle->read_out) {
       // pngle_on_data() usually returns n, otherwise -1 on error
-      if (pngle_on_data(pngle, read_ptr, n) < 0) return -1;
+      if (pngle_on_data(pngle, pngle->read_out, pngle->next_out - pngle->read_out) < 0) return -1;
+      pngle->read_out = pngle->next_out;
+    }
 
+    if (status == TINFL_STATUS_DONE || pngle->avail_out == 0) {
       // XXX: tinfl_decompress always requires (next_out - lz_buf + avail_out) == TINFL_LZ_DICT_SIZE
       pngle->next_out = pngle->lz_buf;
+      pngle->read_out = pngle->lz_buf;
       pngle->avail_out = TINFL_LZ_DICT_SIZE;
     }
 
@@ -688,7 +1522,7 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
     pngle->chunk_remain = read_uint32(buf);
     pngle->chunk_type = read_uint32(buf + 4);
 
-    pngle->crc32 = mz_crc32(MZ_CRC32_INIT, (const mz_uint8 *)(buf + 4), 4);
+    if (!pngle->trusted) pngle->crc32 = mz_crc32(MZ_CRC32_INIT, (const mz_uint8 *)(buf + 4), 4);
 
     debug_printf("[pngle] Chunk '%.4s' len %u\n", buf + 4, pngle->chunk_remain);
 
@@ -709,7 +1543,10 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
       if (pngle->next_out == NULL) {
         // Very first IDAT
         pngle->next_out = pngle->lz_buf;
+        pngle->read_out = pngle->lz_buf;
         pngle->avail_out = TINFL_LZ_DICT_SIZE;
+
+        if (select_kernels(pngle) < 0) return -1;
       }
       break;
 
@@ -731,7 +1568,7 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
 
       if (pngle->chunk_remain % 3) return PNGLE_ERROR("Invalid PLTE chunk size");
       if (pngle->chunk_remain / 3 > MIN(256, (1UL << pngle->hdr.depth))) return PNGLE_ERROR("Too many palettes in PLTE");
-      if ((pngle->palette = PNGLE_CALLOC(pngle->chunk_remain / 3, 3, "palette")) == NULL) return PNGLE_ERROR("Insufficient memory");
+      if ((pngle->palette = PNGLE_ALLOC(pngle->chunk_remain / 3, 3, "palette")) == NULL) return PNGLE_ERROR("Insufficient memory");
       pngle->n_palettes = 0;
       break;
 
@@ -759,7 +1596,7 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
       default:
         return PNGLE_ERROR("tRNS chunk is prohibited on the color type");
       }
-      if ((pngle->trans_palette = PNGLE_CALLOC(pngle->chunk_remain, 1, "trans palette")) == NULL) return PNGLE_ERROR("Insufficient memory");
+      if ((pngle->trans_palette = PNGLE_ALLOC(pngle->chunk_remain, 1, "trans palette")) == NULL) return PNGLE_ERROR("Insufficient memory");
       pngle->n_trans_palettes = 0;
       break;
 
@@ -778,9 +1615,9 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
       if (pngle->chunk_remain < (uint32_t)consumed) return PNGLE_ERROR("Chunk data has been consumed too much");
 
       pngle->chunk_remain -= consumed;
-      pngle->crc32 = mz_crc32(pngle->crc32, (const mz_uint8 *)buf, consumed);
+      if (!pngle->trusted) pngle->crc32 = mz_crc32(pngle->crc32, (const mz_uint8 *)buf, consumed);
     }
-    if (pngle->chunk_remain <= 0) pngle->state = PNGLE_STATE_CRC;
+    if (pngle->chunk_remain <= 0 && pngle->state == PNGLE_STATE_HANDLE_CHUNK) pngle->state = PNGLE_STATE_CRC; // may have hit EOF early (pngle_set_clip())
 
     return consumed;
 
@@ -789,7 +1626,7 @@ static int pngle_feed_internal(pngle_t *pngle, const uint8_t *buf, size_t len)
 
     uint32_t crc32 = read_uint32(buf);
 
-    if (crc32 != pngle->crc32) {
+    if (!pngle->trusted && crc32 != pngle->crc32) {
       debug_printf("[pngle] CRC: %08x vs %08x => NG\n", crc32, (uint32_t)pngle->crc32);
       return PNGLE_ERROR("CRC mismatch");
     }
@@ -828,6 +1665,7 @@ int pngle_feed(pngle_t *pngle, const void *buf, size_t len)
     pos += r;
   }
 
+  PNGLE_STATS_ADD(bytes_fed, pos);
   return pos;
 }
 
@@ -853,6 +1691,75 @@ void pngle_set_draw_callback(pngle_t *pngle, pngle_draw_callback_t callback)
   pngle->draw_callback = callback;
 }
 
+void pngle_set_row_callback(pngle_t *pngle, pngle_row_callback_t callback)
+{
+  if (!pngle) return ;
+  pngle->row_callback = callback;
+}
+
+void pngle_set_trusted(pngle_t *pngle, int trusted)
+{
+  if (!pngle) return ;
+  pngle->trusted = trusted;
+}
+
+void pngle_set_background(pngle_t *pngle, uint8_t r, uint8_t g, uint8_t b)
+{
+  if (!pngle) return ;
+  pngle->blend_enabled = 1;
+  pngle->blend_bg[0] = r;
+  pngle->blend_bg[1] = g;
+  pngle->blend_bg[2] = b;
+}
+
+void pngle_clear_background(pngle_t *pngle)
+{
+  if (!pngle) return ;
+  pngle->blend_enabled = 0;
+}
+
+void pngle_set_scale(pngle_t *pngle, int shift)
+{
+  if (!pngle) return ;
+  pngle->scale_shift = shift < 0 ? 0 : shift > 3 ? 3 : shift;
+}
+
+void pngle_set_clip(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+  if (!pngle) return ;
+  pngle->clip_enabled = 1;
+  pngle->clip_x0 = x;
+  pngle->clip_y0 = y;
+  pngle->clip_x1 = U32_CLAMP_ADD(x, w, UINT32_MAX);
+  pngle->clip_y1 = U32_CLAMP_ADD(y, h, UINT32_MAX);
+}
+
+void pngle_clear_clip(pngle_t *pngle)
+{
+  if (!pngle) return ;
+  pngle->clip_enabled = 0;
+}
+
+void pngle_set_output_format(pngle_t *pngle, pngle_output_format_t format)
+{
+  if (!pngle) return ;
+  pngle->output_format = format;
+}
+
+int pngle_is_opaque(pngle_t *pngle)
+{
+  if (!pngle) return 0;
+  if (pngle->blend_enabled) return 1; // composited over the background
+  return !(pngle->hdr.color_type & 4) && pngle->n_trans_palettes == 0;
+}
+
+const uint8_t *pngle_get_row_mask(pngle_t *pngle)
+{
+  if (!pngle) return NULL;
+  if (pngle_is_opaque(pngle)) return NULL;
+  return pngle->row_mask;
+}
+
 void pngle_set_done_callback(pngle_t *pngle, pngle_done_callback_t callback)
 {
   if (!pngle) return ;
@@ -871,4 +1778,15 @@ void *pngle_get_user_data(pngle_t *pngle)
   return pngle->user_data;
 }
 
+const pngle_stats_t *pngle_get_stats(pngle_t *pngle)
+{
+#ifdef PNGLE_STATS
+  if (!pngle) return NULL;
+  return &pngle->stats;
+#else
+  PNGLE_UNUSED(pngle);
+  return NULL;
+#endif
+}
+
 /* vim: set ts=4 sw=4 noexpandtab: */
@@ -34,9 +34,16 @@ extern "C" {
 // Main Pngle object
 typedef struct _pngle_t pngle_t;
 
+// Pixel layout handed to the row callback
+typedef enum {
+  PNGLE_OUTPUT_RGBA8888 = 0, // 4 bytes per pixel: r, g, b, a
+  PNGLE_OUTPUT_RGB565BE,     // 2 bytes per pixel, high byte first (ready for TFT pushImage), alpha via pngle_get_row_mask()
+} pngle_output_format_t;
+
 // Callback signatures
 typedef void (*pngle_init_callback_t)(pngle_t *pngle, uint32_t w, uint32_t h);
 typedef void (*pngle_draw_callback_t)(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4]);
+typedef void (*pngle_row_callback_t)(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t n, const void *pixels); // n pixels from (x, y) in the selected output format
 typedef void (*pngle_done_callback_t)(pngle_t *pngle);
 
 // ----------------
@@ -45,16 +52,30 @@ typedef void (*pngle_done_callback_t)(pngle_t *pngle);
 pngle_t *pngle_new();
 void pngle_destroy(pngle_t *pngle);
 void pngle_reset(pngle_t *pngle); // clear its internal state (not applied to pngle_set_* functions)
+pngle_t *pngle_pool_acquire(); // statically allocated context, reset and with default settings; NULL if all are in use
+void pngle_pool_release(pngle_t *pngle); // hand it back for the next image (pngle_destroy() does the same for pool contexts)
 const char *pngle_error(pngle_t *pngle);
-int pngle_feed(pngle_t *pngle, const void *buf, size_t len); // returns -1: On error, 0: Need more data, n: n bytes eaten
+int pngle_feed(pngle_t *pngle, const void *buf, size_t len); // returns -1: On error, 0: Need more data, n: n bytes eaten. buf is read in place (memory-mapped flash is fine), a whole image may go in one call; resume from buf + n
 
 uint32_t pngle_get_width(pngle_t *pngle);
 uint32_t pngle_get_height(pngle_t *pngle);
 
 void pngle_set_init_callback(pngle_t *png, pngle_init_callback_t callback);
 void pngle_set_draw_callback(pngle_t *png, pngle_draw_callback_t callback);
+void pngle_set_row_callback(pngle_t *png, pngle_row_callback_t callback); // receives whole scanlines instead of pixels; interlaced passes other than the last still go to the draw callback
 void pngle_set_done_callback(pngle_t *png, pngle_done_callback_t callback);
 
+void pngle_set_output_format(pngle_t *pngle, pngle_output_format_t format); // pixel layout of the row callback; set before feeding
+int pngle_is_opaque(pngle_t *pngle); // 1 if every pixel comes out with alpha 255 (no alpha channel or tRNS, or pngle_set_background()); valid from the first draw
+const uint8_t *pngle_get_row_mask(pngle_t *pngle); // RGB565BE rows: 1 bit per pixel (MSB first, set = opaque), NULL if the image has no transparency
+
+void pngle_set_trusted(pngle_t *pngle, int trusted); // skip chunk CRC checks, for data verified at build time (tools/png_to_header.py); keep them for anything read at runtime
+void pngle_set_background(pngle_t *pngle, uint8_t r, uint8_t g, uint8_t b); // blend transparent pixels over this color; every pixel drawn is then opaque
+void pngle_clear_background(pngle_t *pngle); // alpha is passed through again (default)
+void pngle_set_scale(pngle_t *pngle, int shift); // draw at 1 / (1 << shift) size, 0 - 3; box averaged, or point sampled on interlaced images (draw callback only). Callbacks and clip use the scaled size
+void pngle_set_clip(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h); // only draw inside this rectangle (output coordinates); decoding ends once it is complete
+void pngle_clear_clip(pngle_t *pngle); // draw the whole image again (default)
+
 void pngle_set_display_gamma(pngle_t *pngle, double display_gamma); // enables gamma correction by specifying display gamma, typically 2.2. No effect when gAMA chunk is missing
 
 void pngle_set_user_data(pngle_t *pngle, void *user_data);
@@ -78,6 +99,20 @@ typedef struct _pngle_ihdr_t {
 // Get IHDR information
 pngle_ihdr_t *pngle_get_ihdr(pngle_t *pngle);
 
+typedef struct _pngle_stats_t {
+  uint32_t bytes_fed;
+  uint32_t bytes_inflated;
+  uint32_t rows_unfiltered;
+  uint32_t pixels_emitted;
+  uint32_t callbacks; // draw and row callbacks
+  uint32_t cycles_inflate; // CPU cycles on Xtensa (ccount), nanoseconds on POSIX hosts, clock() ticks elsewhere
+  uint32_t cycles_unfilter;
+  uint32_t cycles_draw; // inside the callbacks
+} pngle_stats_t;
+
+// Get decoding counters of the current image, NULL unless built with PNGLE_STATS
+const pngle_stats_t *pngle_get_stats(pngle_t *pngle);
+
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,9 @@
  // Speeds up the drawing of PNG's
 #define USE_LINE_BUFFER
+// ... and sends the line buffers by DMA while the next pixels are decoded (falls back to blocking pushes without it)
+#define USE_PNG_DMA
+// Bytes of decoded images kept to redraw them without decoding (in PSRAM when the board has it), 0 = none
+#define PNG_CACHE_BYTES (16 * 1024)
 
 // Import the functions needed for the display.
 #include <SPI.h>